@@ -0,0 +1,35 @@
+#!/bin/sh
+# Run xattr_bench on tmpfs and on loop mounted ext4 and xfs images, one
+# JSON line per case on stdout. Mounting needs root; file systems whose
+# mkfs is missing are skipped. Extra arguments go to xattr_bench, e.g.
+#   sudo ./run.sh -n 20000 -t 1,8 > results.json
+set -e
+
+cd "$(dirname "$0")"
+make -s xattr_bench
+
+work=$(mktemp -d /tmp/xattr_bench.XXXXXX)
+cleanup() {
+	for fs in tmpfs ext4 xfs; do
+		umount "$work/$fs" 2>/dev/null || true
+	done
+	rm -rf "$work"
+}
+trap cleanup EXIT INT TERM
+
+mkdir "$work/tmpfs"
+mount -t tmpfs -o size=256m tmpfs "$work/tmpfs"
+./xattr_bench -d "$work/tmpfs" -l tmpfs "$@"
+
+for fs in ext4 xfs; do
+	if ! command -v "mkfs.$fs" >/dev/null 2>&1; then
+		echo "skipping $fs, mkfs.$fs not found" >&2
+		continue
+	fi
+	truncate -s 512M "$work/$fs.img"
+	"mkfs.$fs" -q "$work/$fs.img" >/dev/null
+	mkdir "$work/$fs"
+	mount -o loop "$work/$fs.img" "$work/$fs"
+	./xattr_bench -d "$work/$fs" -l "$fs" "$@"
+	umount "$work/$fs"
+done
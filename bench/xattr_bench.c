@@ -0,0 +1,395 @@
+/*
+  Micro benchmark of the isdk_xattr backend.
+
+  Every thread works on a file of its own inside the target directory,
+  which holds a number of attributes of the given size. For each
+  combination of operation, value size, attribute count and thread count
+  every call is timed, and one line is printed with the throughput of all
+  threads together and the latency percentiles of single calls:
+
+    {"fs":"tmpfs","op":"get","size":16,"attrs":1,"threads":1,"ops":100000,
+     "errors":0,"ops_per_sec":1234567.8,"p50_ns":700,"p99_ns":1500,"max_ns":21000}
+
+  or the same as CSV with -f csv. See run.sh for running it on tmpfs and
+  loop mounted ext4 and xfs images.
+*/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "isdk_xattr.h"
+
+#define BENCH_MAX_LIST	32
+#define BENCH_LIST_BUF	(64 * 1024)
+
+enum bench_op { OP_GET, OP_SET, OP_LIST, OP_FGET, OP_FSET, OP_FLIST, OP_COUNT };
+
+static const char *op_names[OP_COUNT] = { "get", "set", "list", "fget", "fset", "flist" };
+
+typedef struct bench_config {
+    const char *dir;
+    const char *label;
+    int csv;
+    long ops;
+    long sizes[BENCH_MAX_LIST];
+    int nsizes;
+    long attrs[BENCH_MAX_LIST];
+    int nattrs;
+    long threads[BENCH_MAX_LIST];
+    int nthreads;
+    int run_op[OP_COUNT];
+} bench_config;
+
+typedef struct bench_thread {
+    pthread_t tid;
+    pthread_barrier_t *start;
+    enum bench_op op;
+    const char *path;
+    long size;
+    long attrs;
+    long ops;
+    uint64_t *lat;          /* ns per call */
+    uint64_t begin, end;
+    long errors;
+    int first_errno;
+} bench_thread;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+
+    return x < y ? -1 : x > y;
+}
+
+static int parse_list(const char *arg, long *out, int max)
+{
+    char *end;
+    int n = 0;
+
+    while (*arg && n < max) {
+        out[n] = strtol(arg, &end, 10);
+        if (end == arg || out[n] <= 0) {
+            return -1;
+        }
+        if (*end == 'k' || *end == 'K') {
+            out[n] *= 1024;
+            end++;
+        }
+        n++;
+        if (*end != ',') {
+            return *end ? -1 : n;
+        }
+        arg = end + 1;
+    }
+    return n;
+}
+
+static void attr_name(char *buf, size_t size, long i)
+{
+    snprintf(buf, size, "user.bench.%ld", i);
+}
+
+/* Create path with attrs attributes of size bytes, returns 0 or an errno */
+static int prepare_file(const char *path, long size, long attrs, const char *value)
+{
+    char name[64];
+    long i;
+    int fd;
+
+    unlink(path);
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        return errno;
+    }
+    close(fd);
+    for (i = 0; i < attrs; i++) {
+        attr_name(name, sizeof(name), i);
+        if (xattr_setxattr(path, name, (void *) value, size, 0, 0) == -1) {
+            return errno;
+        }
+    }
+    return 0;
+}
+
+static void *run_thread(void *arg)
+{
+    bench_thread *t = (bench_thread *) arg;
+    char name[64], *buf, *names;
+    uint64_t begin;
+    ssize_t rv = 0;
+    long i;
+    int fd;
+
+    buf = malloc(t->size > 0 ? t->size : 1);
+    names = malloc(BENCH_LIST_BUF);
+    memset(buf, 'x', t->size);
+    fd = open(t->path, O_RDONLY);
+
+    pthread_barrier_wait(t->start);
+    t->begin = now_ns();
+    for (i = 0; i < t->ops; i++) {
+        attr_name(name, sizeof(name), i % t->attrs);
+        begin = now_ns();
+        switch (t->op) {
+            case OP_GET:
+                rv = xattr_getxattr(t->path, name, buf, t->size, 0, 0);
+                break;
+            case OP_SET:
+                rv = xattr_setxattr(t->path, name, buf, t->size, 0, 0);
+                break;
+            case OP_LIST:
+                rv = xattr_listxattr(t->path, names, BENCH_LIST_BUF, 0);
+                break;
+            case OP_FGET:
+                rv = xattr_fgetxattr(fd, name, buf, t->size, 0, 0);
+                break;
+            case OP_FSET:
+                rv = xattr_fsetxattr(fd, name, buf, t->size, 0, 0);
+                break;
+            case OP_FLIST:
+                rv = xattr_flistxattr(fd, names, BENCH_LIST_BUF, 0);
+                break;
+            default:
+                break;
+        }
+        t->lat[i] = now_ns() - begin;
+        if (rv == -1 && t->errors++ == 0) {
+            t->first_errno = errno;
+        }
+    }
+    t->end = now_ns();
+
+    if (fd != -1) {
+        close(fd);
+    }
+    free(names);
+    free(buf);
+    return NULL;
+}
+
+static void report(const bench_config *cfg, enum bench_op op, long size, long attrs, long nthreads,
+                   long ops, long errors, int err, double secs, uint64_t *lat)
+{
+    uint64_t p50, p99, max;
+
+    qsort(lat, ops, sizeof(*lat), cmp_u64);
+    p50 = lat[ops / 2];
+    p99 = lat[(ops * 99) / 100];
+    max = lat[ops - 1];
+
+    if (cfg->csv) {
+        printf("%s,%s,%ld,%ld,%ld,%ld,%ld,%s,%.1f,%llu,%llu,%llu\n", cfg->label, op_names[op], size, attrs, nthreads,
+               ops, errors, errors ? strerror(err) : "", ops / secs,
+               (unsigned long long) p50, (unsigned long long) p99, (unsigned long long) max);
+    } else {
+        printf("{\"fs\":\"%s\",\"op\":\"%s\",\"size\":%ld,\"attrs\":%ld,\"threads\":%ld,\"ops\":%ld,\"errors\":%ld,",
+               cfg->label, op_names[op], size, attrs, nthreads, ops, errors);
+        if (errors) {
+            printf("\"error\":\"%s\",", strerror(err));
+        }
+        printf("\"ops_per_sec\":%.1f,\"p50_ns\":%llu,\"p99_ns\":%llu,\"max_ns\":%llu}\n", ops / secs,
+               (unsigned long long) p50, (unsigned long long) p99, (unsigned long long) max);
+    }
+    fflush(stdout);
+}
+
+static void report_skip(const bench_config *cfg, enum bench_op op, long size, long attrs, long nthreads, int err)
+{
+    if (cfg->csv) {
+        printf("%s,%s,%ld,%ld,%ld,0,0,%s,,,,\n", cfg->label, op_names[op], size, attrs, nthreads, strerror(err));
+    } else {
+        printf("{\"fs\":\"%s\",\"op\":\"%s\",\"size\":%ld,\"attrs\":%ld,\"threads\":%ld,\"skipped\":\"%s\"}\n",
+               cfg->label, op_names[op], size, attrs, nthreads, strerror(err));
+    }
+    fflush(stdout);
+}
+
+static void run_case(const bench_config *cfg, enum bench_op op, long size, long attrs, long nthreads, const char *value)
+{
+    pthread_barrier_t start;
+    bench_thread *threads;
+    uint64_t *lat, begin = 0, end = 0;
+    char (*paths)[4096];
+    long i, total;
+    double secs;
+    int err = 0, first_errno = 0;
+    long errors = 0;
+
+    threads = calloc(nthreads, sizeof(*threads));
+    paths = calloc(nthreads, sizeof(*paths));
+    total = cfg->ops * nthreads;
+    lat = malloc(total * sizeof(*lat));
+
+    for (i = 0; i < nthreads && !err; i++) {
+        snprintf(paths[i], sizeof(paths[i]), "%s/xattr_bench.%ld.%ld", cfg->dir, (long) getpid(), i);
+        err = prepare_file(paths[i], size, attrs, value);
+    }
+    if (err) {
+        report_skip(cfg, op, size, attrs, nthreads, err);
+        goto out;
+    }
+
+    pthread_barrier_init(&start, NULL, nthreads + 1);
+    for (i = 0; i < nthreads; i++) {
+        threads[i].start = &start;
+        threads[i].op = op;
+        threads[i].path = paths[i];
+        threads[i].size = size;
+        threads[i].attrs = attrs;
+        threads[i].ops = cfg->ops;
+        threads[i].lat = lat + i * cfg->ops;
+        pthread_create(&threads[i].tid, NULL, run_thread, &threads[i]);
+    }
+    pthread_barrier_wait(&start);
+    for (i = 0; i < nthreads; i++) {
+        pthread_join(threads[i].tid, NULL);
+        /* From the first thread starting to the last one done */
+        if (!begin || threads[i].begin < begin) {
+            begin = threads[i].begin;
+        }
+        if (threads[i].end > end) {
+            end = threads[i].end;
+        }
+        if (threads[i].errors && !errors) {
+            first_errno = threads[i].first_errno;
+        }
+        errors += threads[i].errors;
+    }
+    secs = (end - begin) / 1e9;
+    pthread_barrier_destroy(&start);
+
+    report(cfg, op, size, attrs, nthreads, total, errors, first_errno, secs, lat);
+
+out:
+    for (i = 0; i < nthreads; i++) {
+        if (paths[i][0]) {
+            unlink(paths[i]);
+        }
+    }
+    free(lat);
+    free(paths);
+    free(threads);
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  -d dir      directory to create the test files in (.)\n"
+        "  -l label    name of the file system for the report (-d)\n"
+        "  -o ops      operations: get,set,list,fget,fset,flist (all)\n"
+        "  -s sizes    value sizes in bytes, k suffix allowed (16,256,4k,64k)\n"
+        "  -a counts   attributes per file (1,16)\n"
+        "  -t counts   threads (1,4)\n"
+        "  -n ops      calls per thread and case (100000)\n"
+        "  -f format   json or csv (json)\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+    bench_config cfg;
+    char *value, *op, *save;
+    long max_size = 0;
+    int c, i, j, k, o;
+
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.dir = ".";
+    cfg.ops = 100000;
+    cfg.nsizes = parse_list("16,256,4k,64k", cfg.sizes, BENCH_MAX_LIST);
+    cfg.nattrs = parse_list("1,16", cfg.attrs, BENCH_MAX_LIST);
+    cfg.nthreads = parse_list("1,4", cfg.threads, BENCH_MAX_LIST);
+    for (o = 0; o < OP_COUNT; o++) {
+        cfg.run_op[o] = 1;
+    }
+
+    while ((c = getopt(argc, argv, "d:l:o:s:a:t:n:f:h")) != -1) {
+        switch (c) {
+            case 'd':
+                cfg.dir = optarg;
+                break;
+            case 'l':
+                cfg.label = optarg;
+                break;
+            case 'o':
+                memset(cfg.run_op, 0, sizeof(cfg.run_op));
+                for (op = strtok_r(optarg, ",", &save); op; op = strtok_r(NULL, ",", &save)) {
+                    for (o = 0; o < OP_COUNT && strcmp(op, op_names[o]); o++);
+                    if (o == OP_COUNT) {
+                        fprintf(stderr, "unknown operation %s\n", op);
+                        return 2;
+                    }
+                    cfg.run_op[o] = 1;
+                }
+                break;
+            case 's':
+                cfg.nsizes = parse_list(optarg, cfg.sizes, BENCH_MAX_LIST);
+                break;
+            case 'a':
+                cfg.nattrs = parse_list(optarg, cfg.attrs, BENCH_MAX_LIST);
+                break;
+            case 't':
+                cfg.nthreads = parse_list(optarg, cfg.threads, BENCH_MAX_LIST);
+                break;
+            case 'n':
+                cfg.ops = strtol(optarg, NULL, 10);
+                break;
+            case 'f':
+                cfg.csv = !strcmp(optarg, "csv");
+                break;
+            default:
+                usage(argv[0]);
+                return c == 'h' ? 0 : 2;
+        }
+    }
+    if (cfg.nsizes <= 0 || cfg.nattrs <= 0 || cfg.nthreads <= 0 || cfg.ops <= 0) {
+        usage(argv[0]);
+        return 2;
+    }
+    if (!cfg.label) {
+        cfg.label = cfg.dir;
+    }
+
+    for (i = 0; i < cfg.nsizes; i++) {
+        if (cfg.sizes[i] > max_size) {
+            max_size = cfg.sizes[i];
+        }
+    }
+    value = malloc(max_size);
+    memset(value, 'v', max_size);
+
+    if (cfg.csv) {
+        printf("fs,op,size,attrs,threads,ops,errors,error,ops_per_sec,p50_ns,p99_ns,max_ns\n");
+    }
+    for (o = 0; o < OP_COUNT; o++) {
+        if (!cfg.run_op[o]) {
+            continue;
+        }
+        for (i = 0; i < cfg.nsizes; i++) {
+            for (j = 0; j < cfg.nattrs; j++) {
+                for (k = 0; k < cfg.nthreads; k++) {
+                    run_case(&cfg, (enum bench_op) o, cfg.sizes[i], cfg.attrs[j], cfg.threads[k], value);
+                }
+            }
+        }
+    }
+
+    free(value);
+    return 0;
+}
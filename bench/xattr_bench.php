@@ -0,0 +1,164 @@
+<?php
+/*
+ * Throughput of the extension functions over a generated tree of files.
+ *
+ *   php bench/xattr_bench.php [--files=10000] [--size=64] [--per-dir=1000]
+ *       [--repeat=3] [--dir=/tmp] [--phases=set,get,list,remove]
+ *       [--save=baseline.json] [--baseline=baseline.json] [--threshold=0.10]
+ *
+ * Every phase makes one call per file: set writes user.bench, get reads it,
+ * list lists the file and remove removes the attribute again. The best of
+ * --repeat runs of each phase is reported as a JSON object on stdout.
+ * --save writes that object to a file, --baseline compares against one and
+ * exits with 1 if any phase is more than --threshold slower than it was.
+ * Baselines only compare runs on the same machine, file system, file count
+ * and value size, which is why those are kept in the file and checked.
+ */
+
+$options = getopt("", array("files:", "size:", "per-dir:", "repeat:", "dir:", "phases:",
+	"save:", "baseline:", "threshold:", "keep"));
+
+$files = isset($options["files"]) ? (int) $options["files"] : 10000;
+$size = isset($options["size"]) ? (int) $options["size"] : 64;
+$per_dir = isset($options["per-dir"]) ? max(1, (int) $options["per-dir"]) : 1000;
+$repeat = isset($options["repeat"]) ? max(1, (int) $options["repeat"]) : 3;
+$base = isset($options["dir"]) ? $options["dir"] : sys_get_temp_dir();
+$phases = explode(",", isset($options["phases"]) ? $options["phases"] : "set,get,list,remove");
+$threshold = isset($options["threshold"]) ? (float) $options["threshold"] : 0.10;
+
+if (!extension_loaded("xattr")) {
+	fwrite(STDERR, "the xattr extension is not loaded\n");
+	exit(2);
+}
+foreach ($phases as $phase) {
+	if (!in_array($phase, array("set", "get", "list", "remove"))) {
+		fwrite(STDERR, "unknown phase $phase\n");
+		exit(2);
+	}
+}
+
+/* The tree: $per_dir files in each of ceil($files / $per_dir) directories */
+$root = rtrim($base, "/") . "/xattr_bench." . getmypid();
+$paths = array();
+fwrite(STDERR, "creating $files files in $root\n");
+mkdir($root);
+for ($i = 0; $i < $files; $i++) {
+	$dir = sprintf("%s/%04d", $root, (int) ($i / $per_dir));
+	if ($i % $per_dir == 0) {
+		mkdir($dir);
+	}
+	$path = sprintf("%s/%06d", $dir, $i);
+	touch($path);
+	$paths[] = $path;
+}
+if (!@xattr_set($paths[0], "user.bench", "probe")) {
+	fwrite(STDERR, "user attributes are not supported in $root\n");
+	exit(2);
+}
+xattr_remove($paths[0], "user.bench");
+
+$value = str_repeat("v", $size);
+$errors = 0;
+
+function bench_phase($phase, $paths, $value, &$errors)
+{
+	$start = microtime(true);
+	switch ($phase) {
+		case "set":
+			foreach ($paths as $path) {
+				if (!xattr_set($path, "user.bench", $value)) {
+					$errors++;
+				}
+			}
+			break;
+		case "get":
+			foreach ($paths as $path) {
+				if (xattr_get($path, "user.bench") === false) {
+					$errors++;
+				}
+			}
+			break;
+		case "list":
+			foreach ($paths as $path) {
+				if (xattr_list($path) === false) {
+					$errors++;
+				}
+			}
+			break;
+		case "remove":
+			foreach ($paths as $path) {
+				if (!xattr_remove($path, "user.bench")) {
+					$errors++;
+				}
+			}
+			break;
+	}
+	return microtime(true) - $start;
+}
+
+$results = array();
+for ($run = 0; $run < $repeat; $run++) {
+	foreach ($phases as $phase) {
+		/* get and list need the attribute, remove takes it away again */
+		if ($phase != "set" && !in_array("set", $phases)) {
+			bench_phase("set", $paths, $value, $errors);
+		}
+		$secs = bench_phase($phase, $paths, $value, $errors);
+		$rate = $files / max($secs, 1e-9);
+		if (!isset($results[$phase]) || $rate > $results[$phase]) {
+			$results[$phase] = $rate;
+		}
+	}
+}
+
+$report = array(
+	"files" => $files,
+	"size" => $size,
+	"php" => PHP_VERSION,
+	"uname" => php_uname("s") . " " . php_uname("r"),
+	"errors" => $errors,
+	"ops_per_sec" => array_map(function ($rate) { return round($rate, 1); }, $results),
+);
+if (function_exists("xattr_stats")) {
+	$report["stats"] = xattr_stats();
+}
+echo json_encode($report), "\n";
+
+if (!isset($options["keep"])) {
+	foreach ($paths as $path) {
+		unlink($path);
+	}
+	for ($d = 0; $d * $per_dir < $files; $d++) {
+		rmdir(sprintf("%s/%04d", $root, $d));
+	}
+	rmdir($root);
+}
+
+if (isset($options["save"])) {
+	file_put_contents($options["save"], json_encode($report) . "\n");
+}
+
+$status = $errors ? 1 : 0;
+if (isset($options["baseline"])) {
+	$baseline = json_decode(file_get_contents($options["baseline"]), true);
+	if (!$baseline || $baseline["files"] != $files || $baseline["size"] != $size) {
+		fwrite(STDERR, "baseline {$options["baseline"]} wasn't made with --files=$files --size=$size\n");
+		exit(2);
+	}
+	foreach ($results as $phase => $rate) {
+		if (!isset($baseline["ops_per_sec"][$phase])) {
+			continue;
+		}
+		$was = $baseline["ops_per_sec"][$phase];
+		$change = ($rate - $was) / $was;
+		$verdict = $change < -$threshold ? "REGRESSION" : "ok";
+		fprintf(STDERR, "%-7s %12.1f ops/s  baseline %12.1f  %+6.1f%%  %s\n", $phase, $rate, $was, $change * 100, $verdict);
+		if ($verdict != "ok") {
+			$status = 1;
+		}
+	}
+}
+if ($errors) {
+	fwrite(STDERR, "$errors calls failed\n");
+}
+exit($status);
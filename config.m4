@@ -5,6 +5,9 @@ PHP_ARG_WITH(xattr, for xattr support,
 Make sure that the comment is aligned:
 [  --with-xattr             Include xattr support])
 
+PHP_ARG_ENABLE(xattr-dtrace, whether to add USDT probes to xattr,
+[  --enable-xattr-dtrace    Add USDT probes for bpftrace, SystemTap or DTrace], no, no)
+
 if test "$PHP_XATTR" != "no"; then
   SEARCH_PATH="/usr/local /usr"
   SEARCH_FOR="/include/attr/attributes.h"
@@ -25,7 +28,38 @@ if test "$PHP_XATTR" != "no"; then
   LIBNAME=attr # you may want to change this
   LIBSYMBOL=attr_get # you most likely want to change this 
 
+  dnl xattr_scan() can read the tree with a pool of worker threads
+  AC_CHECK_HEADERS([pthread.h], [
+    AC_CHECK_LIB(pthread, pthread_create, [
+      PHP_ADD_LIBRARY(pthread, 1, XATTR_SHARED_LIBADD)
+    ])
+  ])
+
+  dnl batches of reads can go through io_uring on Linux 5.19 and later
+  AC_CHECK_HEADERS([linux/io_uring.h], [
+    AC_CHECK_DECL(IORING_OP_GETXATTR, [
+      AC_DEFINE(HAVE_IORING_OP_GETXATTR, 1, [Whether io_uring has xattr ops])
+    ], [], [#include <linux/io_uring.h>])
+  ])
+
+  dnl large values can be stored deflated, see xattr.compress
+  AC_CHECK_HEADERS([zlib.h], [
+    AC_CHECK_LIB(z, compress2, [
+      PHP_ADD_LIBRARY(z, 1, XATTR_SHARED_LIBADD)
+      AC_DEFINE(HAVE_XATTR_ZLIB, 1, [Whether values can be compressed with zlib])
+    ])
+  ])
+
+  dnl static probes for tracers, see trace/
+  if test "$PHP_XATTR_DTRACE" != "no"; then
+    AC_CHECK_HEADERS([sys/sdt.h], [
+      AC_DEFINE(HAVE_XATTR_DTRACE, 1, [Whether the backend has USDT probes])
+    ], [
+      AC_MSG_ERROR([--enable-xattr-dtrace needs sys/sdt.h, e.g. from systemtap-sdt-dev])
+    ])
+  fi
+
   PHP_SUBST(XATTR_SHARED_LIBADD)
 
-  PHP_NEW_EXTENSION(xattr, xattr.c isdk_xattr.c, $ext_shared)
+  PHP_NEW_EXTENSION(xattr, xattr.c isdk_xattr.c isdk_xattr_scan.c isdk_xattr_uring.c isdk_xattr_shm.c isdk_xattr_bundle.c isdk_xattr_stats.c, $ext_shared)
 fi
@@ -25,6 +25,27 @@
 #include <errno.h>
 #include <string.h>
 #include "isdk_xattr.h"
+#include "isdk_xattr_stats.h"
+#include "isdk_xattr_probes.h"
+
+/*
+ * The functions below are the plain implementations, under a raw_ prefix.
+ * The public names are defined at the end of the file, they count calls
+ * when xattr_stats_on is set and otherwise go straight through. Calls the
+ * implementations make to each other aren't counted twice that way.
+ */
+#define xattr_getxattr xattr_raw_getxattr
+#define xattr_setxattr xattr_raw_setxattr
+#define xattr_removexattr xattr_raw_removexattr
+#define xattr_listxattr xattr_raw_listxattr
+#define xattr_fgetxattr xattr_raw_fgetxattr
+#define xattr_fsetxattr xattr_raw_fsetxattr
+#define xattr_fremovexattr xattr_raw_fremovexattr
+#define xattr_flistxattr xattr_raw_flistxattr
+#define xattr_getxattrat xattr_raw_getxattrat
+#define xattr_setxattrat xattr_raw_setxattrat
+#define xattr_removexattrat xattr_raw_removexattrat
+#define xattr_listxattrat xattr_raw_listxattrat
 
 #define XATTR_PREFIX  "user."
 
@@ -40,6 +61,13 @@
 #include <sys/xattr.h>
 #endif
 
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
 #ifdef __FreeBSD__
 
 /* FreeBSD compatibility API */
@@ -536,7 +564,7 @@ static void convert_bsd_list(char *namebuf, size_t size)
     } else if (options != 0) {
         return -1;
     }
-    if (options & XATTR_XATTR_NOFOLLOW) {
+    if (nofollow) {
         return -1;
     } else {
         return fsetxattr(fd, name, value, size, options);
@@ -566,17 +594,423 @@ static void convert_bsd_list(char *namebuf, size_t size)
     }
 }
 
-#else /* Mac OS X assumed */
-#define xattr_getxattr getxattr
-#define xattr_fgetxattr fgetxattr
-#define xattr_removexattr removexattr
-#define xattr_fremovexattr fremovexattr
-#define xattr_setxattr setxattr
-#define xattr_fsetxattr fsetxattr
-#define xattr_listxattr listxattr
-#define xattr_flistxattr flistxattr
+#else /* Mac OS X assumed, whose API the others emulate */
+#define XATTR_MAC_OPTIONS (XATTR_XATTR_NOFOLLOW | XATTR_XATTR_CREATE | XATTR_XATTR_REPLACE)
+
+ ssize_t xattr_getxattr(const char *path, const char *name, void *value, ssize_t size, uint32_t position, int options) {
+    return getxattr(path, name, value, size, position, options & XATTR_MAC_OPTIONS);
+}
+
+ ssize_t xattr_setxattr(const char *path, const char *name, void *value, ssize_t size, uint32_t position, int options) {
+    return setxattr(path, name, value, size, position, options & XATTR_MAC_OPTIONS);
+}
+
+ ssize_t xattr_removexattr(const char *path, const char *name, int options) {
+    return removexattr(path, name, options & XATTR_MAC_OPTIONS);
+}
+
+ ssize_t xattr_listxattr(const char *path, char *namebuf, size_t size, int options) {
+    return listxattr(path, namebuf, size, options & XATTR_MAC_OPTIONS);
+}
+
+ ssize_t xattr_fgetxattr(int fd, const char *name, void *value, ssize_t size, uint32_t position, int options) {
+    return fgetxattr(fd, name, value, size, position, options & XATTR_MAC_OPTIONS);
+}
+
+ ssize_t xattr_fsetxattr(int fd, const char *name, void *value, ssize_t size, uint32_t position, int options) {
+    return fsetxattr(fd, name, value, size, position, options & XATTR_MAC_OPTIONS);
+}
+
+ ssize_t xattr_fremovexattr(int fd, const char *name, int options) {
+    return fremovexattr(fd, name, options & XATTR_MAC_OPTIONS);
+}
+
+ ssize_t xattr_flistxattr(int fd, char *namebuf, size_t size, int options) {
+    return flistxattr(fd, namebuf, size, options & XATTR_MAC_OPTIONS);
+}
+#endif
+
+/*
+ * Directory relative API. Linux 6.13 and later have system calls which look
+ * up a single component below an open directory; anywhere else, or when the
+ * kernel doesn't know them, the file is opened relative to the directory.
+ *
+ * Where there is O_PATH that open needs neither read permission nor opening
+ * the file itself, and with XATTR_XATTR_NOFOLLOW the descriptor refers to a
+ * symbolic link rather than to what it points to. The descriptor functions
+ * refuse such a descriptor, so the path functions are called with the
+ * /proc/self/fd link of it; /proc has to be mounted for that. Anywhere else
+ * the file is opened for reading and the descriptor functions are used; a
+ * symbolic link can't be opened that way, XATTR_XATTR_NOFOLLOW on one fails
+ * with EOPNOTSUPP.
+ */
+#if defined(__linux__) && !defined(__NR_getxattrat)
+/* These numbers are shared by all the architectures below */
+#if (defined(__x86_64__) && !defined(__ILP32__)) || defined(__i386__) || \
+    defined(__aarch64__) || defined(__arm__) || defined(__riscv)
+#define __NR_setxattrat 463
+#define __NR_getxattrat 464
+#define __NR_listxattrat 465
+#define __NR_removexattrat 466
+#endif
+#endif
+
+#ifdef __NR_getxattrat
+/* struct xattr_args from <linux/xattr.h> */
+struct xattr_at_args {
+    uint64_t value;
+    uint32_t size;
+    uint32_t flags;
+};
+
+/* Cleared once the kernel answers ENOSYS, by whichever thread sees it first */
+static int xattr_at_syscalls = 1;
+
+#define XATTR_AT_SYSCALLS() __atomic_load_n(&xattr_at_syscalls, __ATOMIC_RELAXED)
+#define XATTR_AT_SYSCALLS_OFF() __atomic_store_n(&xattr_at_syscalls, 0, __ATOMIC_RELAXED)
+
+#define XATTR_AT_FLAGS(options) \
+    (((options) & XATTR_XATTR_NOFOLLOW) ? AT_SYMLINK_NOFOLLOW : 0)
+#endif
+
+#if defined(O_PATH) && defined(__linux__)
+#define XATTR_AT_PROC 1
+/* "/proc/self/fd/" and the digits of an int */
+#define XATTR_AT_PROC_SIZE 32
+#endif
+
+static int xattr_openat(int dirfd, const char *path, int options)
+{
+#ifdef XATTR_AT_PROC
+    int flags = O_PATH;
+#else
+    int flags = O_RDONLY | O_NONBLOCK | O_NOCTTY;
+    int fd;
+#endif
+
+#ifdef O_CLOEXEC
+    flags |= O_CLOEXEC;
+#endif
+#ifdef O_NOFOLLOW
+    if (options & XATTR_XATTR_NOFOLLOW) {
+        flags |= O_NOFOLLOW;
+    }
+#endif
+#ifdef XATTR_AT_PROC
+    return openat(dirfd, path, flags);
+#else
+    fd = openat(dirfd, path, flags);
+    /* A symbolic link, see the top of this part */
+    if (fd == -1 && (options & XATTR_XATTR_NOFOLLOW) && (errno == ELOOP || errno == EMLINK)) {
+        errno = EOPNOTSUPP;
+    }
+    return fd;
+#endif
+}
+
+static void xattr_closeat(int fd)
+{
+    int saved_errno = errno;
+
+    close(fd);
+    errno = saved_errno;
+}
+
+ ssize_t xattr_getxattrat(int dirfd, const char *path, const char *name,
+                              void *value, ssize_t size, int options)
+{
+    ssize_t rv;
+    int fd;
+#ifdef XATTR_AT_PROC
+    char proc[XATTR_AT_PROC_SIZE];
 #endif
 
+#ifdef __NR_getxattrat
+    if (XATTR_AT_SYSCALLS()) {
+        struct xattr_at_args args;
+
+        args.value = (uintptr_t) value;
+        args.size = size;
+        args.flags = 0;
+        rv = syscall(__NR_getxattrat, dirfd, path, XATTR_AT_FLAGS(options),
+                     name, &args, sizeof(args));
+        if (rv != -1 || errno != ENOSYS) {
+            return rv;
+        }
+        XATTR_AT_SYSCALLS_OFF();
+    }
+#endif
+    fd = xattr_openat(dirfd, path, options);
+    if (fd == -1) {
+        return -1;
+    }
+#ifdef XATTR_AT_PROC
+    snprintf(proc, sizeof(proc), "/proc/self/fd/%d", fd);
+    rv = xattr_getxattr(proc, name, value, size, 0, 0);
+#else
+    rv = xattr_fgetxattr(fd, name, value, size, 0, 0);
+#endif
+    xattr_closeat(fd);
+    return rv;
+}
+
+ ssize_t xattr_setxattrat(int dirfd, const char *path, const char *name,
+                              void *value, ssize_t size, int options)
+{
+    ssize_t rv;
+    int fd;
+#ifdef XATTR_AT_PROC
+    char proc[XATTR_AT_PROC_SIZE];
+#endif
+
+#ifdef __NR_setxattrat
+    if (XATTR_AT_SYSCALLS()) {
+        struct xattr_at_args args;
+
+        args.value = (uintptr_t) value;
+        args.size = size;
+        args.flags = 0;
+        if (options & XATTR_XATTR_CREATE) {
+            args.flags = XATTR_CREATE;
+        } else if (options & XATTR_XATTR_REPLACE) {
+            args.flags = XATTR_REPLACE;
+        }
+        rv = syscall(__NR_setxattrat, dirfd, path, XATTR_AT_FLAGS(options),
+                     name, &args, sizeof(args));
+        if (rv != -1 || errno != ENOSYS) {
+            return rv;
+        }
+        XATTR_AT_SYSCALLS_OFF();
+    }
+#endif
+    fd = xattr_openat(dirfd, path, options);
+    if (fd == -1) {
+        return -1;
+    }
+#ifdef XATTR_AT_PROC
+    snprintf(proc, sizeof(proc), "/proc/self/fd/%d", fd);
+    rv = xattr_setxattr(proc, name, value, size, 0, options & ~XATTR_XATTR_NOFOLLOW);
+#else
+    rv = xattr_fsetxattr(fd, name, value, size, 0, options & ~XATTR_XATTR_NOFOLLOW);
+#endif
+    xattr_closeat(fd);
+    return rv;
+}
+
+ ssize_t xattr_removexattrat(int dirfd, const char *path, const char *name,
+                                 int options)
+{
+    ssize_t rv;
+    int fd;
+#ifdef XATTR_AT_PROC
+    char proc[XATTR_AT_PROC_SIZE];
+#endif
+
+#ifdef __NR_removexattrat
+    if (XATTR_AT_SYSCALLS()) {
+        rv = syscall(__NR_removexattrat, dirfd, path, XATTR_AT_FLAGS(options),
+                     name);
+        if (rv != -1 || errno != ENOSYS) {
+            return rv;
+        }
+        XATTR_AT_SYSCALLS_OFF();
+    }
+#endif
+    fd = xattr_openat(dirfd, path, options);
+    if (fd == -1) {
+        return -1;
+    }
+#ifdef XATTR_AT_PROC
+    snprintf(proc, sizeof(proc), "/proc/self/fd/%d", fd);
+    rv = xattr_removexattr(proc, name, 0);
+#else
+    rv = xattr_fremovexattr(fd, name, 0);
+#endif
+    xattr_closeat(fd);
+    return rv;
+}
+
+ ssize_t xattr_listxattrat(int dirfd, const char *path, char *namebuf,
+                               size_t size, int options)
+{
+    ssize_t rv;
+    int fd;
+#ifdef XATTR_AT_PROC
+    char proc[XATTR_AT_PROC_SIZE];
+#endif
+
+#ifdef __NR_listxattrat
+    if (XATTR_AT_SYSCALLS()) {
+        rv = syscall(__NR_listxattrat, dirfd, path, XATTR_AT_FLAGS(options),
+                     namebuf, size);
+        if (rv != -1 || errno != ENOSYS) {
+            return rv;
+        }
+        XATTR_AT_SYSCALLS_OFF();
+    }
+#endif
+    fd = xattr_openat(dirfd, path, options);
+    if (fd == -1) {
+        return -1;
+    }
+#ifdef XATTR_AT_PROC
+    snprintf(proc, sizeof(proc), "/proc/self/fd/%d", fd);
+    rv = xattr_listxattr(proc, namebuf, size, 0);
+#else
+    rv = xattr_flistxattr(fd, namebuf, size, 0);
+#endif
+    xattr_closeat(fd);
+    return rv;
+}
+
+/*
+ * The public functions, see the top of the file
+ */
+#undef xattr_getxattr
+#undef xattr_setxattr
+#undef xattr_removexattr
+#undef xattr_listxattr
+#undef xattr_fgetxattr
+#undef xattr_fsetxattr
+#undef xattr_fremovexattr
+#undef xattr_flistxattr
+#undef xattr_getxattrat
+#undef xattr_setxattrat
+#undef xattr_removexattrat
+#undef xattr_listxattrat
+
+/* bytes is what a successful call moved, rv stands for its result */
+#define XATTR_COUNTED(op, rv, call, bytes) \
+    do { \
+        if (!xattr_stats_on) { \
+            rv = call; \
+        } else { \
+            uint64_t start = xattr_stats_now(); \
+            rv = call; \
+            xattr_stats_record(op, start, rv, errno, rv < 0 ? 0 : (size_t) (bytes)); \
+        } \
+    } while (0)
+
+ ssize_t xattr_getxattr(const char *path, const char *name, void *value, ssize_t size, uint32_t position, int options)
+{
+    ssize_t rv;
+
+    XATTR_PROBE3(getxattr__entry, path, name, size);
+    XATTR_COUNTED(XATTR_OP_GET, rv, xattr_raw_getxattr(path, name, value, size, position, options), size ? rv : 0);
+    XATTR_PROBE4(getxattr__return, path, name, size, rv);
+    return rv;
+}
+
+ ssize_t xattr_setxattr(const char *path, const char *name, void *value, ssize_t size, uint32_t position, int options)
+{
+    ssize_t rv;
+
+    XATTR_PROBE3(setxattr__entry, path, name, size);
+    XATTR_COUNTED(XATTR_OP_SET, rv, xattr_raw_setxattr(path, name, value, size, position, options), size);
+    XATTR_PROBE4(setxattr__return, path, name, size, rv);
+    return rv;
+}
+
+ ssize_t xattr_removexattr(const char *path, const char *name, int options)
+{
+    ssize_t rv;
+
+    XATTR_PROBE3(removexattr__entry, path, name, 0);
+    XATTR_COUNTED(XATTR_OP_REMOVE, rv, xattr_raw_removexattr(path, name, options), 0);
+    XATTR_PROBE4(removexattr__return, path, name, 0, rv);
+    return rv;
+}
+
+ ssize_t xattr_listxattr(const char *path, char *namebuf, size_t size, int options)
+{
+    ssize_t rv;
+
+    XATTR_PROBE3(listxattr__entry, path, NULL, size);
+    XATTR_COUNTED(XATTR_OP_LIST, rv, xattr_raw_listxattr(path, namebuf, size, options), size ? rv : 0);
+    XATTR_PROBE4(listxattr__return, path, NULL, size, rv);
+    return rv;
+}
+
+ ssize_t xattr_fgetxattr(int fd, const char *name, void *value, ssize_t size, uint32_t position, int options)
+{
+    ssize_t rv;
+
+    XATTR_PROBE3(fgetxattr__entry, fd, name, size);
+    XATTR_COUNTED(XATTR_OP_FGET, rv, xattr_raw_fgetxattr(fd, name, value, size, position, options), size ? rv : 0);
+    XATTR_PROBE4(fgetxattr__return, fd, name, size, rv);
+    return rv;
+}
+
+ ssize_t xattr_fsetxattr(int fd, const char *name, void *value, ssize_t size, uint32_t position, int options)
+{
+    ssize_t rv;
+
+    XATTR_PROBE3(fsetxattr__entry, fd, name, size);
+    XATTR_COUNTED(XATTR_OP_FSET, rv, xattr_raw_fsetxattr(fd, name, value, size, position, options), size);
+    XATTR_PROBE4(fsetxattr__return, fd, name, size, rv);
+    return rv;
+}
+
+ ssize_t xattr_fremovexattr(int fd, const char *name, int options)
+{
+    ssize_t rv;
+
+    XATTR_PROBE3(fremovexattr__entry, fd, name, 0);
+    XATTR_COUNTED(XATTR_OP_FREMOVE, rv, xattr_raw_fremovexattr(fd, name, options), 0);
+    XATTR_PROBE4(fremovexattr__return, fd, name, 0, rv);
+    return rv;
+}
+
+ ssize_t xattr_flistxattr(int fd, char *namebuf, size_t size, int options)
+{
+    ssize_t rv;
+
+    XATTR_PROBE3(flistxattr__entry, fd, NULL, size);
+    XATTR_COUNTED(XATTR_OP_FLIST, rv, xattr_raw_flistxattr(fd, namebuf, size, options), size ? rv : 0);
+    XATTR_PROBE4(flistxattr__return, fd, NULL, size, rv);
+    return rv;
+}
+
+ ssize_t xattr_getxattrat(int dirfd, const char *path, const char *name, void *value, ssize_t size, int options)
+{
+    ssize_t rv;
+
+    XATTR_PROBE4(getxattrat__entry, path, name, size, dirfd);
+    XATTR_COUNTED(XATTR_OP_GETAT, rv, xattr_raw_getxattrat(dirfd, path, name, value, size, options), size ? rv : 0);
+    XATTR_PROBE5(getxattrat__return, path, name, size, rv, dirfd);
+    return rv;
+}
+
+ ssize_t xattr_setxattrat(int dirfd, const char *path, const char *name, void *value, ssize_t size, int options)
+{
+    ssize_t rv;
+
+    XATTR_PROBE4(setxattrat__entry, path, name, size, dirfd);
+    XATTR_COUNTED(XATTR_OP_SETAT, rv, xattr_raw_setxattrat(dirfd, path, name, value, size, options), size);
+    XATTR_PROBE5(setxattrat__return, path, name, size, rv, dirfd);
+    return rv;
+}
+
+ ssize_t xattr_removexattrat(int dirfd, const char *path, const char *name, int options)
+{
+    ssize_t rv;
+
+    XATTR_PROBE4(removexattrat__entry, path, name, 0, dirfd);
+    XATTR_COUNTED(XATTR_OP_REMOVEAT, rv, xattr_raw_removexattrat(dirfd, path, name, options), 0);
+    XATTR_PROBE5(removexattrat__return, path, name, 0, rv, dirfd);
+    return rv;
+}
+
+ ssize_t xattr_listxattrat(int dirfd, const char *path, char *namebuf, size_t size, int options)
+{
+    ssize_t rv;
+
+    XATTR_PROBE4(listxattrat__entry, path, NULL, size, dirfd);
+    XATTR_COUNTED(XATTR_OP_LISTAT, rv, xattr_raw_listxattrat(dirfd, path, namebuf, size, options), size ? rv : 0);
+    XATTR_PROBE5(listxattrat__return, path, NULL, size, rv, dirfd);
+    return rv;
+}
+
  bool IsXattrExists(const char* aFile, const char* aKey)
 {
     ssize_t vLen = xattr_getxattr(aFile, aKey, NULL, 0, 0, 0);
@@ -587,32 +1021,47 @@ static void convert_bsd_list(char *namebuf, size_t size)
 #include <stdio.h>
 #include <stdlib.h>
 #include <fcntl.h>
-#include "testhelp.h"
+#include <sys/stat.h>
+
+static int test_count = 0, test_failed = 0;
+#define test_cond(descr, _c) do { \
+    test_count++; \
+    printf("%d - %s: ", test_count, descr); \
+    if (_c) printf("PASSED\n"); else { printf("FAILED\n"); test_failed++; } \
+} while (0)
 
-//gcc --std=c99 -I.  -o test -DHAVE_UNISTD_H -DISDK_XATTR_TEST_MAIN isdk_xattr.c sds.c zmalloc.c
+//gcc -std=c99 -D_GNU_SOURCE -I. -o test -DHAVE_UNISTD_H -DISDK_XATTR_TEST_MAIN isdk_xattr.c isdk_xattr_stats.c
 int main(void) {
     {
+        char value[32], names[256];
+        ssize_t len;
         int fd = open ("mytestfile", O_WRONLY | O_CREAT | O_NONBLOCK | O_NOCTTY,
 		   S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH);
         if (fd != -1) close(fd);
         test_cond("touch('mytestfile')", fd != -1);
 
-        sds path = sdsnew("mytestfile"), key = sdsnew("mydname"), value = sdsnew("hi world!");
-        test_cond("SetXattr(mytestfile, mydname, 'hi world!')", SetXattr(path, key, value)== 0);
-        test_cond("IsXattrExists(mytestfile, mydname)", IsXattrExists(path, key));
-        test_cond("IsXattrExists(mytestfile, notexists)", !IsXattrExists(path, "notexists"));
-        test_cond("IsXattrExists(nosuchmytestfile, notexists)", !IsXattrExists("nosuchmytestfile", "notexists"));
-        sds result = GetXattr(path, key);
-        test_cond("GetXattr(mytestfile, mydname)",
-                result && sdslen(result) == 9 && memcmp(result, "hi world!\0", 10) == 0
-        );
-        sdsfree(path);
-        sdsfree(key);
-        sdsfree(value);
-        if (result) sdsfree(result);
+        test_cond("xattr_setxattr(mytestfile, user.mydname, 'hi world!')",
+                xattr_setxattr("mytestfile", "user.mydname", "hi world!", 9, 0, 0) == 0);
+        test_cond("IsXattrExists(mytestfile, user.mydname)", IsXattrExists("mytestfile", "user.mydname"));
+        test_cond("IsXattrExists(mytestfile, user.notexists)", !IsXattrExists("mytestfile", "user.notexists"));
+        test_cond("IsXattrExists(nosuchmytestfile, user.notexists)", !IsXattrExists("nosuchmytestfile", "user.notexists"));
+        len = xattr_getxattr("mytestfile", "user.mydname", value, sizeof(value), 0, 0);
+        test_cond("xattr_getxattr(mytestfile, user.mydname)", len == 9 && memcmp(value, "hi world!", 9) == 0);
+        len = xattr_listxattr("mytestfile", names, sizeof(names), 0);
+        test_cond("xattr_listxattr(mytestfile)", len > 0 && memmem(names, len, "user.mydname", 13) != NULL);
+
+        fd = open("mytestfile", O_RDONLY);
+        test_cond("xattr_fsetxattr(fd, user.other, 'fd')", xattr_fsetxattr(fd, "user.other", "fd", 2, 0, 0) == 0);
+        len = xattr_fgetxattr(fd, "user.other", value, sizeof(value), 0, 0);
+        test_cond("xattr_fgetxattr(fd, user.other)", len == 2 && memcmp(value, "fd", 2) == 0);
+        test_cond("xattr_fremovexattr(fd, user.other)", xattr_fremovexattr(fd, "user.other", 0) == 0);
+        close(fd);
+
+        test_cond("xattr_removexattr(mytestfile, user.mydname)", xattr_removexattr("mytestfile", "user.mydname", 0) == 0);
+        test_cond("IsXattrExists(mytestfile, user.mydname) after removal", !IsXattrExists("mytestfile", "user.mydname"));
         remove("mytestfile");
     }
-    test_report();
-    return 0;
+    printf("%d tests, %d passed, %d failed\n", test_count, test_count - test_failed, test_failed);
+    return test_failed != 0;
 }
 #endif
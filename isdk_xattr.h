@@ -23,7 +23,9 @@
 #ifndef isdk_xattr__h
  #define isdk_xattr__h
 
+#ifdef HAVE_CONFIG_H
 #include "config.h"
+#endif
 #include <stdbool.h>
 #include <stdint.h>
 #ifdef HAVE_UNISTD_H
@@ -77,6 +79,16 @@
  ssize_t xattr_fremovexattr(int fd, const char *name, int options);
  ssize_t xattr_flistxattr(int fd, char *namebuf, size_t size, int options);
 
+//relative to an open directory, path should be a single component:
+ ssize_t xattr_getxattrat(int dirfd, const char *path, const char *name,
+                              void *value, ssize_t size, int options);
+ ssize_t xattr_setxattrat(int dirfd, const char *path, const char *name,
+                              void *value, ssize_t size, int options);
+ ssize_t xattr_removexattrat(int dirfd, const char *path, const char *name,
+                                 int options);
+ ssize_t xattr_listxattrat(int dirfd, const char *path, char *namebuf,
+                               size_t size, int options);
+
 
  bool IsXattrExists(const char* aFile, const char* aKey);
 
@@ -0,0 +1,196 @@
+/*
+  Copyright (c) 2012 Riceball LEE(riceball.lee@gmail.com)
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+
+//packing many fields into one attribute...
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "isdk_xattr_bundle.h"
+
+#define BUNDLE_VERSION 1
+
+static uint32_t get_u32(const char *p)
+{
+    const unsigned char *u = (const unsigned char *) p;
+
+    return (uint32_t) u[0] | (uint32_t) u[1] << 8 | (uint32_t) u[2] << 16 | (uint32_t) u[3] << 24;
+}
+
+static void put_u32(char *p, uint32_t v)
+{
+    unsigned char *u = (unsigned char *) p;
+
+    u[0] = (unsigned char) v;
+    u[1] = (unsigned char) (v >> 8);
+    u[2] = (unsigned char) (v >> 16);
+    u[3] = (unsigned char) (v >> 24);
+}
+
+static int name_cmp(const char *a, size_t a_len, const char *b, size_t b_len)
+{
+    int rv = memcmp(a, b, a_len < b_len ? a_len : b_len);
+
+    if (rv) {
+        return rv;
+    }
+    return a_len < b_len ? -1 : a_len > b_len;
+}
+
+/* Read entry i, 0 if it points outside of the buffer */
+static int bundle_entry(const char *buf, size_t len, size_t i, xattr_bundle_field *field)
+{
+    const char *entry = buf + XATTR_BUNDLE_HEADER_SIZE + i * XATTR_BUNDLE_ENTRY_SIZE;
+    size_t name_off = get_u32(entry), value_off = get_u32(entry + 8);
+
+    field->name_len = get_u32(entry + 4);
+    field->value_len = get_u32(entry + 12);
+    if (name_off > len || field->name_len >= len - name_off || buf[name_off + field->name_len] != '\0'
+        || value_off > len || field->value_len > len - value_off) {
+        return 0;
+    }
+    field->name = buf + name_off;
+    field->value = buf + value_off;
+    return 1;
+}
+
+/* The header alone, returns the count or -1 */
+static long bundle_header(const char *buf, size_t len)
+{
+    size_t count;
+
+    if (len < XATTR_BUNDLE_HEADER_SIZE || buf[0] != 'X' || buf[1] != 'B' || buf[2] != BUNDLE_VERSION) {
+        return -1;
+    }
+    count = get_u32(buf + 4);
+    if (count > (len - XATTR_BUNDLE_HEADER_SIZE) / XATTR_BUNDLE_ENTRY_SIZE) {
+        return -1;
+    }
+    return (long) count;
+}
+
+ long xattr_bundle_count(const char *buf, size_t len)
+{
+    xattr_bundle_field field, prev;
+    long count = bundle_header(buf, len), i;
+
+    for (i = 0; i < count; i++) {
+        if (!bundle_entry(buf, len, (size_t) i, &field)
+            || (i > 0 && name_cmp(prev.name, prev.name_len, field.name, field.name_len) >= 0)) {
+            return -1;
+        }
+        prev = field;
+    }
+    return count;
+}
+
+ void xattr_bundle_field_at(const char *buf, size_t i, xattr_bundle_field *field)
+{
+    /* Already checked, the length only has to be big enough */
+    bundle_entry(buf, (size_t) -1, i, field);
+}
+
+ int xattr_bundle_find(const char *buf, size_t len, const char *name, size_t name_len, xattr_bundle_field *field)
+{
+    long count = bundle_header(buf, len);
+    size_t lo = 0, hi, mid;
+    int rv;
+
+    if (count < 0) {
+        return -1;
+    }
+    hi = (size_t) count;
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (!bundle_entry(buf, len, mid, field)) {
+            return -1;
+        }
+        rv = name_cmp(name, name_len, field->name, field->name_len);
+        if (rv == 0) {
+            return 1;
+        }
+        if (rv < 0) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    return 0;
+}
+
+static int field_cmp(const void *a, const void *b)
+{
+    const xattr_bundle_field *fa = a, *fb = b;
+
+    return name_cmp(fa->name, fa->name_len, fb->name, fb->name_len);
+}
+
+ void xattr_bundle_sort(xattr_bundle_field *fields, size_t count)
+{
+    if (count > 1) {
+        qsort(fields, count, sizeof(*fields), field_cmp);
+    }
+}
+
+ size_t xattr_bundle_size(const xattr_bundle_field *fields, size_t count)
+{
+    size_t size = XATTR_BUNDLE_HEADER_SIZE, i;
+
+    if (count > (UINT32_MAX - size) / XATTR_BUNDLE_ENTRY_SIZE) {
+        return 0;
+    }
+    size += count * XATTR_BUNDLE_ENTRY_SIZE;
+    for (i = 0; i < count; i++) {
+        if (fields[i].name_len >= UINT32_MAX - size
+            || fields[i].value_len > UINT32_MAX - size - fields[i].name_len - 1) {
+            return 0;
+        }
+        size += fields[i].name_len + 1 + fields[i].value_len;
+    }
+    return size;
+}
+
+ void xattr_bundle_encode(const xattr_bundle_field *fields, size_t count, char *out)
+{
+    char *entry = out + XATTR_BUNDLE_HEADER_SIZE;
+    size_t off = XATTR_BUNDLE_HEADER_SIZE + count * XATTR_BUNDLE_ENTRY_SIZE, i;
+
+    out[0] = 'X';
+    out[1] = 'B';
+    out[2] = BUNDLE_VERSION;
+    out[3] = 0;
+    put_u32(out + 4, (uint32_t) count);
+
+    /* Each name is followed by a NUL and its value */
+    for (i = 0; i < count; i++, entry += XATTR_BUNDLE_ENTRY_SIZE) {
+        put_u32(entry, (uint32_t) off);
+        put_u32(entry + 4, (uint32_t) fields[i].name_len);
+        memcpy(out + off, fields[i].name, fields[i].name_len);
+        off += fields[i].name_len;
+        out[off++] = '\0';
+        put_u32(entry + 8, (uint32_t) off);
+        put_u32(entry + 12, (uint32_t) fields[i].value_len);
+        memcpy(out + off, fields[i].value, fields[i].value_len);
+        off += fields[i].value_len;
+    }
+}
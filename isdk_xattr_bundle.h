@@ -0,0 +1,74 @@
+/*
+  Copyright (c) 2012 Riceball LEE(riceball.lee@gmail.com)
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+
+#ifndef isdk_xattr_bundle__h
+ #define isdk_xattr_bundle__h
+
+#include <stddef.h>
+
+ #ifdef __cplusplus
+ extern "C"
+ {
+ #endif
+
+/*
+ * Many named fields packed into one attribute value. All numbers are
+ * little endian:
+ *
+ *   "XB" version(1) 0 count(4)         header, 8 bytes
+ *   name_off(4) name_len(4) value_off(4) value_len(4)   count times,
+ *                                      sorted by name
+ *   names and values                   anywhere after the directory
+ *
+ * Offsets count from the start of the value. Every name is followed by a
+ * NUL, which its length doesn't count.
+ */
+#define XATTR_BUNDLE_HEADER_SIZE 8
+#define XATTR_BUNDLE_ENTRY_SIZE 16
+
+typedef struct xattr_bundle_field {
+    const char *name;
+    size_t name_len;
+    const char *value;
+    size_t value_len;
+} xattr_bundle_field;
+
+//number of fields, or -1 if buf isn't a well formed bundle:
+ long xattr_bundle_count(const char *buf, size_t len);
+//the i-th field by name order, buf must have passed xattr_bundle_count():
+ void xattr_bundle_field_at(const char *buf, size_t i, xattr_bundle_field *field);
+//looks a field up without going through the others, 1 if found, 0 if not, -1 if buf is malformed:
+ int xattr_bundle_find(const char *buf, size_t len, const char *name, size_t name_len, xattr_bundle_field *field);
+
+//sorts fields by name, names must be unique:
+ void xattr_bundle_sort(xattr_bundle_field *fields, size_t count);
+//size of the bundle holding fields, 0 if it would be too large:
+ size_t xattr_bundle_size(const xattr_bundle_field *fields, size_t count);
+//writes the bundle of sorted fields to out, which has room for xattr_bundle_size() bytes:
+ void xattr_bundle_encode(const xattr_bundle_field *fields, size_t count, char *out);
+
+ #ifdef __cplusplus
+ }
+ #endif
+
+#endif
@@ -0,0 +1,52 @@
+/*
+  Copyright (c) 2012 Riceball LEE(riceball.lee@gmail.com)
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+
+#ifndef isdk_xattr_probes__h
+ #define isdk_xattr_probes__h
+
+/*
+ * USDT probes of provider xattr, see the scripts in trace/. Configured with
+ * --enable-xattr-dtrace they are sys/sdt.h probes, which are a single nop
+ * each until a tracer attaches. The arguments are plain variables already
+ * at hand, so nothing is computed for them either. Otherwise they're gone.
+ *
+ * The wrappers in isdk_xattr.c fire <call>__entry(target, name, size) and
+ * <call>__return(target, name, size, result), where target is the path or
+ * the fd, name is NULL for the list calls and size 0 for the remove calls.
+ * The *at calls pass the dirfd as one more argument. Batches run through
+ * io_uring fire batch__submit(opcode, path, fd, name, size) as each op is
+ * queued and batch__complete(opcode, path, fd, name, result) as it's reaped.
+ */
+#ifdef HAVE_XATTR_DTRACE
+#include <sys/sdt.h>
+
+#define XATTR_PROBE3(probe, a, b, c) DTRACE_PROBE3(xattr, probe, a, b, c)
+#define XATTR_PROBE4(probe, a, b, c, d) DTRACE_PROBE4(xattr, probe, a, b, c, d)
+#define XATTR_PROBE5(probe, a, b, c, d, e) DTRACE_PROBE5(xattr, probe, a, b, c, d, e)
+#else
+#define XATTR_PROBE3(probe, a, b, c)
+#define XATTR_PROBE4(probe, a, b, c, d)
+#define XATTR_PROBE5(probe, a, b, c, d, e)
+#endif
+
+#endif
@@ -0,0 +1,859 @@
+/*
+  Copyright (c) 2012 Riceball LEE(riceball.lee@gmail.com)
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+
+//walking a whole tree and collecting the attributes of every file in it...
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "isdk_xattr_scan.h"
+#include "isdk_xattr_stats.h"
+
+#ifdef HAVE_PTHREAD_H
+#define XATTR_SCAN_THREADS 1
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/time.h>
+#endif
+
+#define XATTR_SCAN_BUFFER_SIZE 1024
+#define XATTR_SCAN_MAX_THREADS 64
+#define XATTR_SCAN_RESULTS     64     /* entries queued per worker thread */
+
+#ifndef O_CLOEXEC
+#define O_CLOEXEC 0
+#endif
+
+/* A growable scratch buffer */
+typedef struct xattr_scan_buf {
+    char *data;
+    size_t len;
+    size_t cap;
+} xattr_scan_buf;
+
+typedef struct xattr_scan_dir {
+    DIR *dir;
+    char *path;             /* the directory itself, including the root */
+    size_t path_len;
+    int depth;              /* level of its entries below the root */
+} xattr_scan_dir;
+
+/*
+ * Everything one thread needs to walk the tree. Directories are read depth
+ * first from the top of the stack, idle workers steal from its bottom: those
+ * are the directories found first, usually with the biggest subtrees left.
+ */
+typedef struct xattr_scan_walker {
+    xattr_scan *scan;
+    xattr_scan_dir *stack;
+    size_t bottom;
+    size_t top;
+    size_t cap;
+    xattr_scan_buf path;    /* the current file, including the root */
+    xattr_scan_buf names;   /* list of names of the current file */
+    xattr_scan_buf data;    /* names and values collected so far */
+    xattr_scan_buf attrs;   /* xattr_scan_attr records holding offsets into data */
+#ifdef XATTR_SCAN_THREADS
+    pthread_mutex_t lock;   /* guards the stack while other workers may steal */
+    pthread_t thread;
+    xattr_stats stats;      /* the worker's calls, once it's done */
+#endif
+} xattr_scan_walker;
+
+struct xattr_scan {
+    xattr_scan_options opts;
+    char *prefix;
+    size_t prefix_len;
+    size_t root_len;
+    int threads;            /* 0 walks in the calling thread with walkers[0] */
+    xattr_scan_walker *walkers;
+#ifdef XATTR_SCAN_THREADS
+    pthread_mutex_t lock;
+    pthread_cond_t work;    /* a directory may be stolen or the walk is over */
+    pthread_cond_t ready;   /* an entry was queued or a worker exited */
+    pthread_cond_t room;    /* an entry was taken from the queue */
+    int started;
+    int running;
+    int idle;
+    int finished;
+    int cancel;
+    int error;
+    int stats_on;           /* xattr_stats_on of the thread which started the walk */
+    int stats_merged;
+    xattr_scan_entry **results;
+    size_t head;
+    size_t count;
+    size_t results_cap;
+#endif
+};
+
+#ifdef XATTR_SCAN_THREADS
+#define SCAN_LOCK(w)    do { if ((w)->scan->threads) pthread_mutex_lock(&(w)->lock); } while (0)
+#define SCAN_UNLOCK(w)  do { if ((w)->scan->threads) pthread_mutex_unlock(&(w)->lock); } while (0)
+#else
+#define SCAN_LOCK(w)
+#define SCAN_UNLOCK(w)
+#endif
+
+static int scan_buf_reserve(xattr_scan_buf *buf, size_t size)
+{
+    char *data;
+
+    if (size <= buf->cap) {
+        return 0;
+    }
+    if (size < buf->cap * 2) {
+        size = buf->cap * 2;
+    }
+    data = realloc(buf->data, size);
+    if (!data) {
+        errno = ENOMEM;
+        return -1;
+    }
+    buf->data = data;
+    buf->cap = size;
+    return 0;
+}
+
+static int scan_buf_append(xattr_scan_buf *buf, const void *data, size_t len)
+{
+    if (scan_buf_reserve(buf, buf->len + len) == -1) {
+        return -1;
+    }
+    memcpy(buf->data + buf->len, data, len);
+    buf->len += len;
+    return 0;
+}
+
+/* Read a value, or the list of names if name is NULL, through fd or by path if fd is -1 */
+static ssize_t scan_call(int fd, const char *path, const char *name, char *value, size_t size)
+{
+    if (fd != -1) {
+        return name ? xattr_fgetxattr(fd, name, value, size, 0, 0)
+                    : xattr_flistxattr(fd, value, size, 0);
+    }
+    return name ? xattr_getxattr(path, name, value, size, 0, XATTR_XATTR_NOFOLLOW)
+                : xattr_listxattr(path, value, size, XATTR_XATTR_NOFOLLOW);
+}
+
+/*
+ * Read into buf at its current length. The first attempt uses whatever room
+ * is left, the size is only asked for when that turns out to be too small.
+ * Returns the number of bytes read, buf->len isn't changed.
+ */
+static ssize_t scan_fetch(int fd, const char *path, const char *name, xattr_scan_buf *buf)
+{
+    ssize_t len, size;
+    size_t room;
+
+    if (scan_buf_reserve(buf, buf->len + XATTR_SCAN_BUFFER_SIZE) == -1) {
+        return -1;
+    }
+    for (;;) {
+        room = buf->cap - buf->len;
+        len = scan_call(fd, path, name, buf->data + buf->len, room);
+        /* a full buffer is all some platforms report on truncation */
+        if (len >= 0 && (size_t) len < room) {
+            return len;
+        }
+        if (len < 0 && errno != ERANGE) {
+            return -1;
+        }
+        size = scan_call(fd, path, name, NULL, 0);
+        if (size < 0) {
+            return -1;
+        }
+        if (size == len) {
+            return len;
+        }
+        if (scan_buf_reserve(buf, buf->len + size + 1) == -1) {
+            return -1;
+        }
+    }
+}
+
+/* Collect the attributes of the file at w->path into a freshly allocated entry */
+static int scan_collect(xattr_scan_walker *w, int fd, int is_dir, xattr_scan_entry **entry)
+{
+    xattr_scan *scan = w->scan;
+    const char *path = w->path.data;
+    const char *p, *end;
+    xattr_scan_attr attr, *attrs;
+    xattr_scan_entry *e;
+    ssize_t list_len, value_len;
+    size_t len, i, count, rel_len;
+    char *data;
+
+    *entry = NULL;
+    w->names.len = 0;
+    w->data.len = 0;
+    w->attrs.len = 0;
+
+    /* Files on filesystems without attributes simply have none */
+    list_len = scan_fetch(fd, path, NULL, &w->names);
+    if (list_len < 0) {
+        if (errno == ENOMEM) {
+            return -1;
+        }
+        list_len = 0;
+    }
+
+    for (p = w->names.data, end = p + list_len; p < end; p += len + 1) {
+        len = strlen(p);
+        if (scan->prefix_len && strncmp(p, scan->prefix, scan->prefix_len)) {
+            continue;
+        }
+
+        attr.name = (const char *) (uintptr_t) w->data.len;
+        attr.name_len = len;
+        if (scan_buf_append(&w->data, p, len + 1) == -1) {
+            return -1;
+        }
+
+        value_len = scan_fetch(fd, path, p, &w->data);
+        if (value_len < 0) {
+            if (errno == ENOMEM) {
+                return -1;
+            }
+            /* removed since it was listed */
+            w->data.len -= len + 1;
+            continue;
+        }
+        attr.value = (const char *) (uintptr_t) w->data.len;
+        attr.value_len = value_len;
+        w->data.len += value_len;
+
+        if (scan_buf_append(&w->attrs, &attr, sizeof(attr)) == -1) {
+            return -1;
+        }
+    }
+
+    count = w->attrs.len / sizeof(xattr_scan_attr);
+    if (!count && scan->opts.skip_empty) {
+        return 0;
+    }
+
+    /* One block: the entry, its attributes, the relative path and then the data */
+    rel_len = w->path.len - scan->root_len - 1;
+    e = malloc(sizeof(*e) + w->attrs.len + rel_len + 1 + w->data.len);
+    if (!e) {
+        errno = ENOMEM;
+        return -1;
+    }
+    attrs = (xattr_scan_attr *) (e + 1);
+    data = (char *) (attrs + count);
+
+    memcpy(data, path + scan->root_len + 1, rel_len + 1);
+    e->path = data;
+    e->path_len = rel_len;
+    e->is_dir = is_dir;
+    e->count = count;
+    e->attrs = attrs;
+
+    data += rel_len + 1;
+    if (w->data.len) {
+        memcpy(data, w->data.data, w->data.len);
+    }
+    memcpy(attrs, w->attrs.data, w->attrs.len);
+    for (i = 0; i < count; i++) {
+        attrs[i].name = data + (uintptr_t) attrs[i].name;
+        attrs[i].value = data + (uintptr_t) attrs[i].value;
+    }
+
+    *entry = e;
+    return 0;
+}
+
+/* Make room for one more frame on the stack of w, the caller holds its lock if needed */
+static int scan_reserve(xattr_scan_walker *w)
+{
+    xattr_scan_dir *stack;
+
+    if (w->top < w->cap) {
+        return 0;
+    }
+    if (w->bottom) {
+        memmove(w->stack, w->stack + w->bottom, (w->top - w->bottom) * sizeof(*stack));
+        w->top -= w->bottom;
+        w->bottom = 0;
+        return 0;
+    }
+    stack = realloc(w->stack, (w->cap * 2 + 8) * sizeof(*stack));
+    if (!stack) {
+        errno = ENOMEM;
+        return -1;
+    }
+    w->stack = stack;
+    w->cap = w->cap * 2 + 8;
+    return 0;
+}
+
+/* Push a directory taking over dir and path */
+static int scan_push(xattr_scan_walker *w, DIR *dir, char *path, size_t path_len, int depth)
+{
+    xattr_scan_dir *frame;
+
+    if (scan_reserve(w) == -1) {
+        return -1;
+    }
+    frame = &w->stack[w->top++];
+    frame->dir = dir;
+    frame->path = path;
+    frame->path_len = path_len;
+    frame->depth = depth;
+    return 0;
+}
+
+/* Descend into the directory open as fd, which is closed unless it's taken over */
+static int scan_descend(xattr_scan_walker *w, int fd, int depth)
+{
+    DIR *dir;
+    char *path;
+    int rv;
+
+    dir = fdopendir(fd);
+    if (!dir) {
+        /* an unreadable directory is just not descended into */
+        close(fd);
+        return 0;
+    }
+    path = malloc(w->path.len + 1);
+    if (!path) {
+        closedir(dir);
+        errno = ENOMEM;
+        return -1;
+    }
+    memcpy(path, w->path.data, w->path.len + 1);
+
+    SCAN_LOCK(w);
+    rv = scan_push(w, dir, path, w->path.len, depth);
+#ifdef XATTR_SCAN_THREADS
+    if (rv == 0 && w->scan->threads && w->top - w->bottom > 1) {
+        pthread_cond_signal(&w->scan->work);
+    }
+#endif
+    SCAN_UNLOCK(w);
+
+    if (rv == -1) {
+        closedir(dir);
+        free(path);
+    }
+    return rv;
+}
+
+/*
+ * The next file from the stack of w, 0 once the stack is empty. Only the
+ * owner of w touches the frame on top, so it's read without holding the lock.
+ */
+static int scan_walk(xattr_scan_walker *w, xattr_scan_entry **entry)
+{
+    xattr_scan *scan = w->scan;
+    xattr_scan_dir frame;
+    struct dirent *de;
+    struct stat sb;
+    int dfd, fd, is_dir, is_reg, rv;
+    size_t name_len;
+
+    *entry = NULL;
+    for (;;) {
+        SCAN_LOCK(w);
+        if (w->top == w->bottom) {
+            w->top = w->bottom = 0;
+            SCAN_UNLOCK(w);
+            return 0;
+        }
+        frame = w->stack[w->top - 1];
+        SCAN_UNLOCK(w);
+
+        de = readdir(frame.dir);
+        if (!de) {
+            SCAN_LOCK(w);
+            w->top--;
+            SCAN_UNLOCK(w);
+            closedir(frame.dir);
+            free(frame.path);
+            continue;
+        }
+        if (de->d_name[0] == '.' && (!de->d_name[1] ||
+            (de->d_name[1] == '.' && !de->d_name[2]))) {
+            continue;
+        }
+
+        name_len = strlen(de->d_name);
+        w->path.len = 0;
+        if (scan_buf_reserve(&w->path, frame.path_len + name_len + 2) == -1) {
+            return -1;
+        }
+        memcpy(w->path.data, frame.path, frame.path_len);
+        w->path.data[frame.path_len] = '/';
+        memcpy(w->path.data + frame.path_len + 1, de->d_name, name_len + 1);
+        w->path.len = frame.path_len + 1 + name_len;
+
+        /* Only regular files and directories are opened, devices may not like it */
+        dfd = dirfd(frame.dir);
+        is_dir = is_reg = 0;
+#ifdef DT_UNKNOWN
+        if (de->d_type != DT_UNKNOWN) {
+            is_dir = de->d_type == DT_DIR;
+            is_reg = de->d_type == DT_REG;
+        } else
+#endif
+        if (fstatat(dfd, de->d_name, &sb, AT_SYMLINK_NOFOLLOW) == 0) {
+            is_dir = S_ISDIR(sb.st_mode);
+            is_reg = S_ISREG(sb.st_mode);
+        }
+
+        fd = -1;
+        if (is_dir || is_reg) {
+            fd = openat(dfd, de->d_name,
+                        O_RDONLY | O_NONBLOCK | O_NOCTTY | O_NOFOLLOW | O_CLOEXEC);
+        }
+
+        rv = scan_collect(w, fd, is_dir, entry);
+
+        if (fd != -1) {
+            if (rv == 0 && is_dir &&
+                (scan->opts.max_depth < 0 || frame.depth < scan->opts.max_depth)) {
+                rv = scan_descend(w, fd, frame.depth + 1);
+            } else {
+                close(fd);
+            }
+        }
+
+        if (rv == -1) {
+            xattr_scan_entry_free(*entry);
+            *entry = NULL;
+            return -1;
+        }
+        if (*entry) {
+            return 1;
+        }
+    }
+}
+
+static void scan_walker_free(xattr_scan_walker *w)
+{
+    size_t i;
+
+    for (i = w->bottom; i < w->top; i++) {
+        closedir(w->stack[i].dir);
+        free(w->stack[i].path);
+    }
+    free(w->stack);
+    free(w->path.data);
+    free(w->names.data);
+    free(w->data.data);
+    free(w->attrs.data);
+}
+
+#ifdef XATTR_SCAN_THREADS
+
+/* Move the oldest directory of another worker to thief, the scan lock is held */
+static int scan_steal(xattr_scan *scan, xattr_scan_walker *thief)
+{
+    xattr_scan_walker *victim;
+    xattr_scan_dir frame;
+    int i, n = scan->started;
+
+    pthread_mutex_lock(&thief->lock);
+    if (scan_reserve(thief) == -1) {
+        pthread_mutex_unlock(&thief->lock);
+        return -1;
+    }
+    pthread_mutex_unlock(&thief->lock);
+
+    for (i = 1; i < n; i++) {
+        victim = &scan->walkers[((thief - scan->walkers) + i) % n];
+
+        pthread_mutex_lock(&victim->lock);
+        /* never the one on top, its owner is reading it */
+        if (victim->top - victim->bottom < 2) {
+            pthread_mutex_unlock(&victim->lock);
+            continue;
+        }
+        frame = victim->stack[victim->bottom++];
+        pthread_mutex_unlock(&victim->lock);
+
+        pthread_mutex_lock(&thief->lock);
+        scan_push(thief, frame.dir, frame.path, frame.path_len, frame.depth);
+        pthread_mutex_unlock(&thief->lock);
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * Called by a worker whose stack ran empty. Returns 1 once it got some work,
+ * 0 when the walk is over: all workers are idle at the same time then.
+ */
+static int scan_find_work(xattr_scan_walker *w)
+{
+    xattr_scan *scan = w->scan;
+    struct timespec ts;
+    struct timeval tv;
+    int rv = 0;
+
+    pthread_mutex_lock(&scan->lock);
+    scan->idle++;
+    while (!scan->cancel && !scan->finished) {
+        rv = scan_steal(scan, w);
+        if (rv) {
+            break;
+        }
+        if (scan->idle == scan->started) {
+            scan->finished = 1;
+            pthread_cond_broadcast(&scan->work);
+            break;
+        }
+        /* Pushes signal without the scan lock, so don't rely on it */
+        gettimeofday(&tv, NULL);
+        ts.tv_sec = tv.tv_sec;
+        ts.tv_nsec = tv.tv_usec * 1000 + 10000000;
+        if (ts.tv_nsec >= 1000000000) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000;
+        }
+        pthread_cond_timedwait(&scan->work, &scan->lock, &ts);
+    }
+    scan->idle--;
+    if (rv == -1 && !scan->error) {
+        scan->error = errno;
+        scan->cancel = 1;
+    }
+    pthread_mutex_unlock(&scan->lock);
+    return rv == 1;
+}
+
+/* Queue an entry for the calling thread, waiting while the queue is full */
+static int scan_put(xattr_scan *scan, xattr_scan_entry *entry)
+{
+    pthread_mutex_lock(&scan->lock);
+    while (scan->count == scan->results_cap && !scan->cancel) {
+        pthread_cond_wait(&scan->room, &scan->lock);
+    }
+    if (scan->cancel) {
+        pthread_mutex_unlock(&scan->lock);
+        xattr_scan_entry_free(entry);
+        return -1;
+    }
+    scan->results[(scan->head + scan->count) % scan->results_cap] = entry;
+    scan->count++;
+    pthread_cond_signal(&scan->ready);
+    pthread_mutex_unlock(&scan->lock);
+    return 0;
+}
+
+/*
+ * Workers count their calls like the thread which started the walk would,
+ * their counters are added to its own once all of them are done.
+ */
+static void scan_stats_merge(xattr_scan *scan)
+{
+    int i;
+
+    if (!scan->stats_on || scan->stats_merged) {
+        return;
+    }
+    for (i = 0; i < scan->started; i++) {
+        xattr_stats_merge(&scan->walkers[i].stats);
+    }
+    scan->stats_merged = 1;
+}
+
+static void *scan_worker(void *arg)
+{
+    xattr_scan_walker *w = arg;
+    xattr_scan *scan = w->scan;
+    xattr_scan_entry *entry;
+    int rv;
+
+    xattr_stats_enable(scan->stats_on);
+    for (;;) {
+        rv = scan_walk(w, &entry);
+        if (rv == 1) {
+            if (scan_put(scan, entry) == -1) {
+                break;
+            }
+        } else if (rv == -1) {
+            pthread_mutex_lock(&scan->lock);
+            if (!scan->error) {
+                scan->error = errno ? errno : EIO;
+            }
+            scan->cancel = 1;
+            pthread_cond_broadcast(&scan->work);
+            pthread_cond_broadcast(&scan->room);
+            pthread_mutex_unlock(&scan->lock);
+            break;
+        } else if (!scan_find_work(w)) {
+            break;
+        }
+    }
+
+    if (scan->stats_on) {
+        memcpy(&w->stats, xattr_stats_get(), sizeof(w->stats));
+    }
+    pthread_mutex_lock(&scan->lock);
+    scan->running--;
+    pthread_cond_broadcast(&scan->ready);
+    pthread_mutex_unlock(&scan->lock);
+    return NULL;
+}
+
+/* Stop the workers and wait for them */
+static void scan_pool_stop(xattr_scan *scan)
+{
+    int i;
+
+    pthread_mutex_lock(&scan->lock);
+    scan->cancel = 1;
+    pthread_cond_broadcast(&scan->work);
+    pthread_cond_broadcast(&scan->room);
+    pthread_mutex_unlock(&scan->lock);
+
+    for (i = 0; i < scan->started; i++) {
+        pthread_join(scan->walkers[i].thread, NULL);
+    }
+    scan_stats_merge(scan);
+    scan->started = 0;
+    while (scan->count) {
+        xattr_scan_entry_free(scan->results[scan->head]);
+        scan->head = (scan->head + 1) % scan->results_cap;
+        scan->count--;
+    }
+}
+
+static int scan_pool_start(xattr_scan *scan)
+{
+    sigset_t all, saved;
+    int i, err = 0;
+
+    pthread_mutex_init(&scan->lock, NULL);
+    pthread_cond_init(&scan->work, NULL);
+    pthread_cond_init(&scan->ready, NULL);
+    pthread_cond_init(&scan->room, NULL);
+    for (i = 0; i < scan->threads; i++) {
+        pthread_mutex_init(&scan->walkers[i].lock, NULL);
+    }
+
+    scan->results_cap = (size_t) scan->threads * XATTR_SCAN_RESULTS;
+    scan->results = malloc(scan->results_cap * sizeof(*scan->results));
+    if (!scan->results) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    /* Signals such as the ones for timeouts are for the calling thread only */
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &saved);
+
+    scan->stats_on = xattr_stats_on;
+
+    pthread_mutex_lock(&scan->lock);
+    for (i = 0; i < scan->threads; i++) {
+        err = pthread_create(&scan->walkers[i].thread, NULL, scan_worker, &scan->walkers[i]);
+        if (err) {
+            break;
+        }
+        scan->started++;
+        scan->running++;
+    }
+    pthread_mutex_unlock(&scan->lock);
+
+    pthread_sigmask(SIG_SETMASK, &saved, NULL);
+
+    if (err) {
+        scan_pool_stop(scan);
+        errno = err;
+        return -1;
+    }
+    return 0;
+}
+
+/* Take the next entry queued by the workers */
+static int scan_pool_next(xattr_scan *scan, xattr_scan_entry **entry)
+{
+    int err;
+
+    pthread_mutex_lock(&scan->lock);
+    while (!scan->count && scan->running && !scan->error) {
+        pthread_cond_wait(&scan->ready, &scan->lock);
+    }
+    if (scan->count) {
+        *entry = scan->results[scan->head];
+        scan->head = (scan->head + 1) % scan->results_cap;
+        scan->count--;
+        pthread_cond_signal(&scan->room);
+        pthread_mutex_unlock(&scan->lock);
+        return 1;
+    }
+    err = scan->error;
+    if (!scan->running) {
+        scan_stats_merge(scan);
+    }
+    pthread_mutex_unlock(&scan->lock);
+
+    if (err) {
+        errno = err;
+        return -1;
+    }
+    return 0;
+}
+
+#endif
+
+ xattr_scan *xattr_scan_open(const char *root, const xattr_scan_options *opts)
+{
+    xattr_scan *scan;
+    size_t root_len = strlen(root);
+    char *path;
+    DIR *dir;
+    int i, saved_errno, walkers = 1;
+
+    scan = calloc(1, sizeof(*scan));
+    if (!scan) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    scan->opts = *opts;
+    if (opts->prefix && *opts->prefix) {
+        scan->prefix_len = strlen(opts->prefix);
+        scan->prefix = strdup(opts->prefix);
+        if (!scan->prefix) {
+            errno = ENOMEM;
+            goto fail;
+        }
+    }
+#ifdef XATTR_SCAN_THREADS
+    if (opts->threads > 0) {
+        walkers = opts->threads > XATTR_SCAN_MAX_THREADS ? XATTR_SCAN_MAX_THREADS : opts->threads;
+    }
+#endif
+    scan->walkers = calloc(walkers, sizeof(*scan->walkers));
+    if (!scan->walkers) {
+        errno = ENOMEM;
+        goto fail;
+    }
+    for (i = 0; i < walkers; i++) {
+        scan->walkers[i].scan = scan;
+    }
+
+    /* Relative paths start right after the root and its slash */
+    while (root_len && root[root_len - 1] == '/') {
+        root_len--;
+    }
+    scan->root_len = root_len;
+
+    path = malloc(root_len + 1);
+    if (!path) {
+        errno = ENOMEM;
+        goto fail;
+    }
+    memcpy(path, root, root_len);
+    path[root_len] = '\0';
+
+    dir = opendir(root);
+    if (!dir || scan_push(&scan->walkers[0], dir, path, root_len, 0) == -1) {
+        saved_errno = errno;
+        if (dir) {
+            closedir(dir);
+        }
+        free(path);
+        errno = saved_errno;
+        goto fail;
+    }
+
+#ifdef XATTR_SCAN_THREADS
+    if (opts->threads > 0) {
+        scan->threads = walkers;
+        if (scan_pool_start(scan) == -1) {
+            goto fail;
+        }
+    }
+#endif
+    return scan;
+
+fail:
+    saved_errno = errno;
+    xattr_scan_close(scan);
+    errno = saved_errno;
+    return NULL;
+}
+
+/*
+ * Returns 1 and the next file below the root in entry, 0 once the whole tree
+ * has been walked or -1 on errors. Files and directories which can't be read
+ * don't stop the walk, they're just reported without attributes or not
+ * descended into. Worker threads report files in no particular order.
+ */
+ int xattr_scan_next(xattr_scan *scan, xattr_scan_entry **entry)
+{
+    *entry = NULL;
+#ifdef XATTR_SCAN_THREADS
+    if (scan->threads) {
+        return scan_pool_next(scan, entry);
+    }
+#endif
+    return scan_walk(&scan->walkers[0], entry);
+}
+
+ void xattr_scan_close(xattr_scan *scan)
+{
+    int i;
+
+    if (!scan) {
+        return;
+    }
+    if (scan->walkers) {
+#ifdef XATTR_SCAN_THREADS
+        if (scan->threads) {
+            scan_pool_stop(scan);
+            free(scan->results);
+            pthread_mutex_destroy(&scan->lock);
+            pthread_cond_destroy(&scan->work);
+            pthread_cond_destroy(&scan->ready);
+            pthread_cond_destroy(&scan->room);
+            for (i = 0; i < scan->threads; i++) {
+                pthread_mutex_destroy(&scan->walkers[i].lock);
+            }
+        }
+#endif
+        for (i = 0; i < (scan->threads ? scan->threads : 1); i++) {
+            scan_walker_free(&scan->walkers[i]);
+        }
+        free(scan->walkers);
+    }
+    free(scan->prefix);
+    free(scan);
+}
+
+ void xattr_scan_entry_free(xattr_scan_entry *entry)
+{
+    free(entry);
+}
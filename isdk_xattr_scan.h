@@ -0,0 +1,69 @@
+/*
+  Copyright (c) 2012 Riceball LEE(riceball.lee@gmail.com)
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#ifndef isdk_xattr_scan__h
+ #define isdk_xattr_scan__h
+
+#include "isdk_xattr.h"
+#include <stddef.h>
+
+ #ifdef __cplusplus
+ extern "C"
+ {
+ #endif
+
+typedef struct xattr_scan_options {
+    const char *prefix;     /* only attributes whose names begin with it */
+    int max_depth;          /* levels below the root to descend, -1 for all */
+    int skip_empty;         /* don't report files without any attribute */
+    int threads;            /* worker threads reading the tree, 0 for none */
+} xattr_scan_options;
+
+typedef struct xattr_scan_attr {
+    const char *name;
+    size_t name_len;
+    const char *value;
+    size_t value_len;
+} xattr_scan_attr;
+
+/* A file found by the scanner, released with xattr_scan_entry_free() */
+typedef struct xattr_scan_entry {
+    const char *path;       /* relative to the root */
+    size_t path_len;
+    int is_dir;
+    size_t count;
+    xattr_scan_attr *attrs;
+} xattr_scan_entry;
+
+typedef struct xattr_scan xattr_scan;
+
+//walks the tree below root depth first, one file per xattr_scan_next() call:
+ xattr_scan *xattr_scan_open(const char *root, const xattr_scan_options *opts);
+ int xattr_scan_next(xattr_scan *scan, xattr_scan_entry **entry);
+ void xattr_scan_close(xattr_scan *scan);
+ void xattr_scan_entry_free(xattr_scan_entry *entry);
+
+ #ifdef __cplusplus
+ }
+ #endif
+
+#endif
@@ -0,0 +1,340 @@
+/*
+  Copyright (c) 2012 Riceball LEE(riceball.lee@gmail.com)
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+
+//a cache of attributes in memory shared between processes...
+//
+//The table is split in sets of XATTR_SHM_WAYS slots, a key can only live in
+//the set its hash points to. Every slot is guarded by a sequence counter:
+//writers make it odd while they change the slot and give up rather than
+//wait when someone else got there first, readers copy the slot without any
+//lock and throw the copy away when the counter moved meanwhile. A process
+//killed in the middle of a write leaves its slot odd, so that one slot is
+//never used again and nothing else is affected.
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include "isdk_xattr_shm.h"
+
+#if defined(__GNUC__) && defined(__ATOMIC_ACQUIRE)
+#include <sys/mman.h>
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#ifdef MAP_ANONYMOUS
+#define XATTR_HAVE_SHM 1
+#endif
+#endif
+
+#ifdef XATTR_HAVE_SHM
+
+#define XATTR_SHM_WAYS 4
+
+typedef struct shm_slot {
+    uint32_t seq;           /* odd while being written */
+    uint32_t name_len;      /* 0 with hash 0 for an empty slot */
+    uint64_t hash;
+    uint64_t dev;
+    uint64_t ino;
+    int64_t ctime;
+    int64_t ctime_nsec;
+    int32_t flags;
+    int32_t len;            /* of the value, -1 for a missing attribute */
+    char kind;
+    char data[XATTR_SHM_DATA_MAX];  /* the name, then the value */
+} shm_slot;
+
+struct xattr_shm {
+    size_t size;            /* of the mapping */
+    size_t sets;
+    shm_slot *slots;
+};
+
+/* Shared by every process, at the start of the mapping */
+typedef struct shm_header {
+    uint32_t victim;        /* spreads evictions over the ways of a set */
+} shm_header;
+
+#define SHM_HEADER_SIZE ((sizeof(shm_header) + 63) & ~(size_t) 63)
+
+static uint64_t shm_hash(const xattr_shm_key *key)
+{
+    uint64_t h = 14695981039346656037ULL;
+    const unsigned char *p;
+    size_t i;
+    uint64_t words[2];
+    unsigned char tail[2];
+
+    words[0] = key->dev;
+    words[1] = key->ino;
+    for (p = (const unsigned char *) words, i = 0; i < sizeof(words); i++) {
+        h = (h ^ p[i]) * 1099511628211ULL;
+    }
+    tail[0] = (unsigned char) key->flags;
+    tail[1] = (unsigned char) key->kind;
+    for (i = 0; i < sizeof(tail); i++) {
+        h = (h ^ tail[i]) * 1099511628211ULL;
+    }
+    for (p = (const unsigned char *) key->name, i = 0; i < key->name_len; i++) {
+        h = (h ^ p[i]) * 1099511628211ULL;
+    }
+    /* 0 marks an empty slot */
+    return h ? h : 1;
+}
+
+static shm_slot *shm_set(xattr_shm *shm, uint64_t hash)
+{
+    return shm->slots + (size_t) (hash % shm->sets) * XATTR_SHM_WAYS;
+}
+
+/* Fields of a slot read under its counter, compared once the copy is known good */
+static int shm_slot_matches(const shm_slot *slot, const xattr_shm_key *key, uint64_t hash)
+{
+    return slot->hash == hash && slot->dev == key->dev && slot->ino == key->ino
+        && slot->flags == key->flags && slot->kind == key->kind
+        && slot->name_len == key->name_len;
+}
+
+static int shm_lock(shm_slot *slot, uint32_t *seq)
+{
+    uint32_t expected = __atomic_load_n(&slot->seq, __ATOMIC_RELAXED);
+
+    if (expected & 1) {
+        return 0;
+    }
+    if (!__atomic_compare_exchange_n(&slot->seq, &expected, expected + 1, 0,
+                                     __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        return 0;
+    }
+    /* Readers seeing any of the following writes also see the odd counter */
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    *seq = expected + 1;
+    return 1;
+}
+
+static void shm_unlock(shm_slot *slot, uint32_t seq)
+{
+    __atomic_store_n(&slot->seq, seq + 1, __ATOMIC_RELEASE);
+}
+
+ xattr_shm *xattr_shm_open(size_t size)
+{
+    xattr_shm *shm;
+    void *map;
+    size_t sets;
+
+    sets = size > SHM_HEADER_SIZE ? (size - SHM_HEADER_SIZE) / (sizeof(shm_slot) * XATTR_SHM_WAYS) : 0;
+    if (!sets) {
+        errno = EINVAL;
+        return NULL;
+    }
+    size = SHM_HEADER_SIZE + sets * XATTR_SHM_WAYS * sizeof(shm_slot);
+
+    shm = malloc(sizeof(*shm));
+    if (!shm) {
+        return NULL;
+    }
+    /* Zero filled, every slot starts out empty and unlocked */
+    map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED) {
+        free(shm);
+        return NULL;
+    }
+    shm->size = size;
+    shm->sets = sets;
+    shm->slots = (shm_slot *) ((char *) map + SHM_HEADER_SIZE);
+    return shm;
+}
+
+ void xattr_shm_close(xattr_shm *shm)
+{
+    if (!shm) {
+        return;
+    }
+    munmap((char *) shm->slots - SHM_HEADER_SIZE, shm->size);
+    free(shm);
+}
+
+ size_t xattr_shm_slots(xattr_shm *shm)
+{
+    return shm ? shm->sets * XATTR_SHM_WAYS : 0;
+}
+
+ ssize_t xattr_shm_get(xattr_shm *shm, const xattr_shm_key *key, int64_t ctime, long ctime_nsec, char *buf, size_t size)
+{
+    uint64_t hash;
+    shm_slot *set;
+    ssize_t len;
+    int i, found;
+
+    if (key->name_len > XATTR_SHM_DATA_MAX) {
+        return XATTR_SHM_MISS;
+    }
+    hash = shm_hash(key);
+    set = shm_set(shm, hash);
+
+    for (i = 0; i < XATTR_SHM_WAYS; i++) {
+        shm_slot *slot = set + i;
+        uint32_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+
+        if ((seq & 1) || slot->hash != hash) {
+            continue;
+        }
+
+        found = shm_slot_matches(slot, key, hash)
+            && slot->ctime == ctime && slot->ctime_nsec == ctime_nsec
+            && memcmp(slot->data, key->name, key->name_len) == 0;
+        len = slot->len;
+        /* Anything read from a slot being rewritten is garbage, bound it first */
+        if (found && len > 0 && ((size_t) len > size || (size_t) len > XATTR_SHM_DATA_MAX - key->name_len)) {
+            found = 0;
+        }
+        if (found && len > 0) {
+            memcpy(buf, slot->data + key->name_len, len);
+        }
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != seq) {
+            continue;
+        }
+        if (found) {
+            return len < 0 ? -1 : len;
+        }
+    }
+    return XATTR_SHM_MISS;
+}
+
+ void xattr_shm_put(xattr_shm *shm, const xattr_shm_key *key, int64_t ctime, long ctime_nsec, const char *value, ssize_t len)
+{
+    shm_header *header;
+    uint64_t hash;
+    shm_slot *set, *slot = NULL;
+    uint32_t seq;
+    size_t value_len = len > 0 ? (size_t) len : 0;
+    int i;
+
+    if (key->name_len + value_len > XATTR_SHM_DATA_MAX) {
+        return;
+    }
+    hash = shm_hash(key);
+    set = shm_set(shm, hash);
+
+    /* The same key again, or else a free slot, or else whatever comes next */
+    for (i = 0; i < XATTR_SHM_WAYS && !slot; i++) {
+        if (__atomic_load_n(&set[i].hash, __ATOMIC_RELAXED) == hash) {
+            slot = set + i;
+        }
+    }
+    for (i = 0; i < XATTR_SHM_WAYS && !slot; i++) {
+        if (__atomic_load_n(&set[i].hash, __ATOMIC_RELAXED) == 0) {
+            slot = set + i;
+        }
+    }
+    if (!slot) {
+        header = (shm_header *) ((char *) shm->slots - SHM_HEADER_SIZE);
+        slot = set + __atomic_fetch_add(&header->victim, 1, __ATOMIC_RELAXED) % XATTR_SHM_WAYS;
+    }
+
+    if (!shm_lock(slot, &seq)) {
+        return;
+    }
+    __atomic_store_n(&slot->hash, hash, __ATOMIC_RELAXED);
+    slot->name_len = (uint32_t) key->name_len;
+    slot->dev = key->dev;
+    slot->ino = key->ino;
+    slot->flags = key->flags;
+    slot->kind = key->kind;
+    slot->ctime = ctime;
+    slot->ctime_nsec = ctime_nsec;
+    slot->len = len < 0 ? -1 : (int32_t) len;
+    memcpy(slot->data, key->name, key->name_len);
+    if (value_len) {
+        memcpy(slot->data + key->name_len, value, value_len);
+    }
+    shm_unlock(slot, seq);
+}
+
+ void xattr_shm_forget(xattr_shm *shm, const xattr_shm_key *key)
+{
+    uint64_t hash;
+    shm_slot *set;
+    uint32_t seq;
+    int i;
+
+    if (key->name_len > XATTR_SHM_DATA_MAX) {
+        return;
+    }
+    hash = shm_hash(key);
+    set = shm_set(shm, hash);
+
+    for (i = 0; i < XATTR_SHM_WAYS; i++) {
+        shm_slot *slot = set + i;
+
+        if (__atomic_load_n(&slot->hash, __ATOMIC_RELAXED) != hash || !shm_lock(slot, &seq)) {
+            continue;
+        }
+        if (shm_slot_matches(slot, key, hash) && memcmp(slot->data, key->name, key->name_len) == 0) {
+            __atomic_store_n(&slot->hash, 0, __ATOMIC_RELAXED);
+            slot->name_len = 0;
+        }
+        shm_unlock(slot, seq);
+    }
+}
+
+#else
+
+ xattr_shm *xattr_shm_open(size_t size)
+{
+    (void) size;
+    errno = ENOSYS;
+    return NULL;
+}
+
+ void xattr_shm_close(xattr_shm *shm)
+{
+    (void) shm;
+}
+
+ size_t xattr_shm_slots(xattr_shm *shm)
+{
+    (void) shm;
+    return 0;
+}
+
+ ssize_t xattr_shm_get(xattr_shm *shm, const xattr_shm_key *key, int64_t ctime, long ctime_nsec, char *buf, size_t size)
+{
+    (void) shm; (void) key; (void) ctime; (void) ctime_nsec; (void) buf; (void) size;
+    return XATTR_SHM_MISS;
+}
+
+ void xattr_shm_put(xattr_shm *shm, const xattr_shm_key *key, int64_t ctime, long ctime_nsec, const char *value, ssize_t len)
+{
+    (void) shm; (void) key; (void) ctime; (void) ctime_nsec; (void) value; (void) len;
+}
+
+ void xattr_shm_forget(xattr_shm *shm, const xattr_shm_key *key)
+{
+    (void) shm; (void) key;
+}
+
+#endif
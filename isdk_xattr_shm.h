@@ -0,0 +1,68 @@
+/*
+  Copyright (c) 2012 Riceball LEE(riceball.lee@gmail.com)
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+
+#ifndef isdk_xattr_shm__h
+ #define isdk_xattr_shm__h
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+ #ifdef __cplusplus
+ extern "C"
+ {
+ #endif
+
+/* Room for the name and the value of one entry */
+#define XATTR_SHM_DATA_MAX 448
+
+#define XATTR_SHM_MISS -2   /* xattr_shm_get() found nothing usable */
+
+/* What an entry is about, kind tells a value from a list of names */
+typedef struct xattr_shm_key {
+    uint64_t dev;
+    uint64_t ino;
+    int flags;
+    char kind;
+    const char *name;
+    size_t name_len;
+} xattr_shm_key;
+
+typedef struct xattr_shm xattr_shm;
+
+//a table of entries shared by this process and every process forked from it later:
+ xattr_shm *xattr_shm_open(size_t size);
+ void xattr_shm_close(xattr_shm *shm);
+
+//copies the value into buf and returns its length, -1 for an attribute known to be missing,
+//XATTR_SHM_MISS when there's no entry for the key or it was stored for another ctime:
+ ssize_t xattr_shm_get(xattr_shm *shm, const xattr_shm_key *key, int64_t ctime, long ctime_nsec, char *buf, size_t size);
+ void xattr_shm_put(xattr_shm *shm, const xattr_shm_key *key, int64_t ctime, long ctime_nsec, const char *value, ssize_t len);
+ void xattr_shm_forget(xattr_shm *shm, const xattr_shm_key *key);
+ size_t xattr_shm_slots(xattr_shm *shm);
+
+ #ifdef __cplusplus
+ }
+ #endif
+
+#endif
@@ -0,0 +1,121 @@
+/*
+  Copyright (c) 2012 Riceball LEE(riceball.lee@gmail.com)
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+
+//counting calls to the xattr backend...
+
+#include <string.h>
+#include <time.h>
+#include "isdk_xattr_stats.h"
+
+ XATTR_STATS_TLS int xattr_stats_on = 0;
+static XATTR_STATS_TLS xattr_stats stats;
+
+static const char *op_names[XATTR_OP_COUNT] = {
+    "get", "fget", "getat",
+    "set", "fset", "setat",
+    "remove", "fremove", "removeat",
+    "list", "flist", "listat",
+    "uring_get", "uring_set"
+};
+
+ void xattr_stats_enable(int on)
+{
+    xattr_stats_on = on;
+}
+
+ void xattr_stats_reset(void)
+{
+    memset(&stats, 0, sizeof(stats));
+}
+
+ const xattr_stats *xattr_stats_get(void)
+{
+    return &stats;
+}
+
+ const char *xattr_stats_op_name(xattr_stats_op op)
+{
+    return (unsigned) op < XATTR_OP_COUNT ? op_names[op] : "unknown";
+}
+
+ uint64_t xattr_stats_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+}
+
+static unsigned bucket_of(uint64_t ns)
+{
+    unsigned bucket = 0;
+
+#if defined(__GNUC__) || defined(__clang__)
+    bucket = 63 - (unsigned) __builtin_clzll(ns | 1);
+#else
+    while (ns >>= 1) {
+        bucket++;
+    }
+#endif
+    return bucket < XATTR_STATS_BUCKETS ? bucket : XATTR_STATS_BUCKETS - 1;
+}
+
+ void xattr_stats_record(xattr_stats_op op, uint64_t start, ssize_t result, int err, size_t bytes)
+{
+    xattr_op_stats *s;
+    uint64_t ns;
+
+    if ((unsigned) op >= XATTR_OP_COUNT) {
+        return;
+    }
+    s = &stats.ops[op];
+    ns = xattr_stats_now() - start;
+
+    s->calls++;
+    s->nsec += ns;
+    s->latency[bucket_of(ns)]++;
+    if (result < 0) {
+        s->errors++;
+        stats.errnos[err > 0 && err < XATTR_STATS_ERRNOS ? err : XATTR_STATS_ERRNOS - 1]++;
+    } else {
+        s->bytes += bytes;
+    }
+}
+
+ void xattr_stats_merge(const xattr_stats *from)
+{
+    int i, j;
+
+    for (i = 0; i < XATTR_OP_COUNT; i++) {
+        stats.ops[i].calls += from->ops[i].calls;
+        stats.ops[i].errors += from->ops[i].errors;
+        stats.ops[i].bytes += from->ops[i].bytes;
+        stats.ops[i].nsec += from->ops[i].nsec;
+        for (j = 0; j < XATTR_STATS_BUCKETS; j++) {
+            stats.ops[i].latency[j] += from->ops[i].latency[j];
+        }
+    }
+    for (i = 0; i < XATTR_STATS_ERRNOS; i++) {
+        stats.errnos[i] += from->errnos[i];
+    }
+}
@@ -0,0 +1,89 @@
+/*
+  Copyright (c) 2012 Riceball LEE(riceball.lee@gmail.com)
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+
+#ifndef isdk_xattr_stats__h
+ #define isdk_xattr_stats__h
+
+#include <stdint.h>
+#include <sys/types.h>
+
+ #ifdef __cplusplus
+ extern "C"
+ {
+ #endif
+
+/*
+ * Counters of the calls made through isdk_xattr and isdk_xattr_uring, kept
+ * per thread. Nothing is recorded until xattr_stats_enable(1), and until
+ * then all a call pays is testing xattr_stats_on.
+ */
+#if defined(__GNUC__) || defined(__clang__)
+#define XATTR_STATS_TLS __thread
+#else
+#define XATTR_STATS_TLS
+#endif
+
+//latency bucket i counts calls which took less than 2^(i+1) ns, the last one everything slower:
+#define XATTR_STATS_BUCKETS 32
+//errno values counted one by one, larger ones share the last slot:
+#define XATTR_STATS_ERRNOS 160
+
+typedef enum xattr_stats_op {
+    XATTR_OP_GET, XATTR_OP_FGET, XATTR_OP_GETAT,
+    XATTR_OP_SET, XATTR_OP_FSET, XATTR_OP_SETAT,
+    XATTR_OP_REMOVE, XATTR_OP_FREMOVE, XATTR_OP_REMOVEAT,
+    XATTR_OP_LIST, XATTR_OP_FLIST, XATTR_OP_LISTAT,
+    XATTR_OP_URING_GET, XATTR_OP_URING_SET,
+    XATTR_OP_COUNT
+} xattr_stats_op;
+
+typedef struct xattr_op_stats {
+    uint64_t calls;
+    uint64_t errors;
+    uint64_t bytes;         /* read or written by successful calls */
+    uint64_t nsec;
+    uint64_t latency[XATTR_STATS_BUCKETS];
+} xattr_op_stats;
+
+typedef struct xattr_stats {
+    xattr_op_stats ops[XATTR_OP_COUNT];
+    uint64_t errnos[XATTR_STATS_ERRNOS];
+} xattr_stats;
+
+extern XATTR_STATS_TLS int xattr_stats_on;
+
+ void xattr_stats_enable(int on);
+ void xattr_stats_reset(void);
+ const xattr_stats *xattr_stats_get(void);
+ const char *xattr_stats_op_name(xattr_stats_op op);
+ uint64_t xattr_stats_now(void);
+//record a call which started at start (xattr_stats_now()), result -1 means it failed with err:
+ void xattr_stats_record(xattr_stats_op op, uint64_t start, ssize_t result, int err, size_t bytes);
+//add the counters of another thread, e.g. a worker which is done, to those of this one:
+ void xattr_stats_merge(const xattr_stats *from);
+
+ #ifdef __cplusplus
+ }
+ #endif
+
+#endif
@@ -0,0 +1,382 @@
+/*
+  Copyright (c) 2012 Riceball LEE(riceball.lee@gmail.com)
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+//batches of xattr calls submitted through io_uring...
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "isdk_xattr_uring.h"
+#include "isdk_xattr_stats.h"
+#include "isdk_xattr_probes.h"
+
+#if defined(__linux__) && defined(HAVE_LINUX_IO_URING_H) && defined(HAVE_IORING_OP_GETXATTR)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <linux/io_uring.h>
+#include <linux/xattr.h>
+#ifdef __NR_io_uring_setup
+#define XATTR_HAVE_URING 1
+#endif
+#endif
+
+/* Plain calls, for when there's no ring or the ring can't express an op */
+static void batch_sync(xattr_batch_op *op)
+{
+    ssize_t rv;
+
+    errno = 0;
+    if (op->opcode == XATTR_BATCH_SET) {
+        rv = op->fd != -1
+            ? xattr_fsetxattr(op->fd, op->name, op->value, op->size, 0, op->options)
+            : xattr_setxattr(op->path, op->name, op->value, op->size, 0, op->options);
+    } else {
+        rv = op->fd != -1
+            ? xattr_fgetxattr(op->fd, op->name, op->value, op->size, 0, op->options)
+            : xattr_getxattr(op->path, op->name, op->value, op->size, 0, op->options);
+    }
+    op->result = rv < 0 ? -1 : rv;
+    /* invalid options are refused without setting errno */
+    op->err = rv < 0 ? (errno ? errno : EINVAL) : 0;
+}
+
+#ifdef XATTR_HAVE_URING
+
+struct xattr_uring {
+    int fd;
+    int broken;             /* a submission failed, don't trust the ring anymore */
+    uint64_t submitted;     /* when the ops in flight were submitted, if xattr_stats_on */
+    unsigned sq_entries;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_ring;
+    size_t sq_ring_size;
+    void *cq_ring;
+    size_t cq_ring_size;
+    size_t sqes_size;
+    unsigned char supported[IORING_OP_LAST];
+};
+
+static int uring_setup(unsigned entries, struct io_uring_params *p)
+{
+    return (int) syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    return (int) syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+/* Ask the kernel which of the xattr opcodes it knows */
+static int uring_probe(xattr_uring *ring)
+{
+    static const int opcodes[] = {
+        IORING_OP_GETXATTR, IORING_OP_FGETXATTR, IORING_OP_SETXATTR, IORING_OP_FSETXATTR
+    };
+    struct io_uring_probe *probe;
+    size_t i;
+    int found = 0;
+
+    probe = calloc(1, sizeof(*probe) + IORING_OP_LAST * sizeof(probe->ops[0]));
+    if (!probe) {
+        return 0;
+    }
+    if (syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_PROBE, probe, IORING_OP_LAST) == 0) {
+        for (i = 0; i < sizeof(opcodes) / sizeof(opcodes[0]); i++) {
+            if (opcodes[i] < probe->ops_len &&
+                (probe->ops[opcodes[i]].flags & IO_URING_OP_SUPPORTED)) {
+                ring->supported[opcodes[i]] = 1;
+                found = 1;
+            }
+        }
+    }
+    free(probe);
+    return found;
+}
+
+ xattr_uring *xattr_uring_open(unsigned entries)
+{
+    struct io_uring_params p;
+    xattr_uring *ring;
+    int saved_errno;
+
+    ring = calloc(1, sizeof(*ring));
+    if (!ring) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    memset(&p, 0, sizeof(p));
+    ring->fd = uring_setup(entries, &p);
+    if (ring->fd < 0) {
+        /* ENOSYS, or EPERM when io_uring is disabled by sysctl or seccomp */
+        free(ring);
+        return NULL;
+    }
+
+    ring->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_ring_size > ring->sq_ring_size) {
+            ring->sq_ring_size = ring->cq_ring_size;
+        }
+        ring->cq_ring_size = 0;
+    }
+
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ring == MAP_FAILED) {
+        ring->sq_ring = NULL;
+        goto fail;
+    }
+    if (ring->cq_ring_size) {
+        ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE,
+                             MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ring == MAP_FAILED) {
+            ring->cq_ring = NULL;
+            goto fail;
+        }
+    } else {
+        ring->cq_ring = ring->sq_ring;
+    }
+    ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        ring->sqes = NULL;
+        goto fail;
+    }
+
+    ring->sq_entries = p.sq_entries;
+    ring->sq_head = (unsigned *) ((char *) ring->sq_ring + p.sq_off.head);
+    ring->sq_tail = (unsigned *) ((char *) ring->sq_ring + p.sq_off.tail);
+    ring->sq_mask = (unsigned *) ((char *) ring->sq_ring + p.sq_off.ring_mask);
+    ring->sq_array = (unsigned *) ((char *) ring->sq_ring + p.sq_off.array);
+    ring->cq_head = (unsigned *) ((char *) ring->cq_ring + p.cq_off.head);
+    ring->cq_tail = (unsigned *) ((char *) ring->cq_ring + p.cq_off.tail);
+    ring->cq_mask = (unsigned *) ((char *) ring->cq_ring + p.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *) ((char *) ring->cq_ring + p.cq_off.cqes);
+
+    /* Kernels before 5.19 have io_uring but no xattr ops */
+    if (!uring_probe(ring)) {
+        errno = ENOSYS;
+        goto fail;
+    }
+    return ring;
+
+fail:
+    saved_errno = errno;
+    xattr_uring_close(ring);
+    errno = saved_errno;
+    return NULL;
+}
+
+ void xattr_uring_close(xattr_uring *ring)
+{
+    if (!ring) {
+        return;
+    }
+    if (ring->sqes) {
+        munmap(ring->sqes, ring->sqes_size);
+    }
+    if (ring->cq_ring && ring->cq_ring != ring->sq_ring) {
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    }
+    if (ring->sq_ring) {
+        munmap(ring->sq_ring, ring->sq_ring_size);
+    }
+    close(ring->fd);
+    free(ring);
+}
+
+/*
+ * Fill in sqe for op, or return 0 if the ring can't do it: io_uring has no
+ * lgetxattr() and friends, so ops not following symbolic links are left out.
+ */
+static int uring_prep(xattr_uring *ring, const xattr_batch_op *op, struct io_uring_sqe *sqe)
+{
+    int options = op->options, flags = 0, opcode;
+
+    if (options & XATTR_XATTR_NOFOLLOW) {
+        return 0;
+    }
+    if (op->opcode == XATTR_BATCH_SET) {
+        if (options == XATTR_XATTR_CREATE) {
+            flags = XATTR_CREATE;
+        } else if (options == XATTR_XATTR_REPLACE) {
+            flags = XATTR_REPLACE;
+        } else if (options != 0) {
+            return 0;
+        }
+        opcode = op->fd != -1 ? IORING_OP_FSETXATTR : IORING_OP_SETXATTR;
+    } else {
+        if (options != 0) {
+            return 0;
+        }
+        opcode = op->fd != -1 ? IORING_OP_FGETXATTR : IORING_OP_GETXATTR;
+    }
+    if (!ring->supported[opcode]) {
+        return 0;
+    }
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->fd = op->fd != -1 ? op->fd : 0;
+    sqe->addr = (uintptr_t) op->name;
+    sqe->addr2 = (uintptr_t) op->value;
+    sqe->len = op->size;
+    sqe->xattr_flags = flags;
+    sqe->addr3 = (uintptr_t) op->path;
+    return 1;
+}
+
+static void uring_reap(xattr_uring *ring, xattr_batch_op *ops, unsigned *done)
+{
+    unsigned head = *ring->cq_head;
+    unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    struct io_uring_cqe *cqe;
+    xattr_batch_op *op;
+
+    while (head != tail) {
+        cqe = &ring->cqes[head & *ring->cq_mask];
+        op = &ops[cqe->user_data];
+        op->result = cqe->res < 0 ? -1 : cqe->res;
+        op->err = cqe->res < 0 ? -cqe->res : 0;
+        XATTR_PROBE5(batch__complete, op->opcode, op->path, op->fd, op->name, op->result);
+        if (xattr_stats_on) {
+            /* Latency here is from submission to being reaped */
+            xattr_stats_record(op->opcode == XATTR_BATCH_SET ? XATTR_OP_URING_SET : XATTR_OP_URING_GET,
+                               ring->submitted, op->result, op->err,
+                               op->opcode == XATTR_BATCH_SET ? op->size : (size_t) op->result);
+        }
+        head++;
+        (*done)++;
+    }
+    __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+}
+
+/*
+ * Submit up to a ring full of ops at a time and wait for all of them with
+ * one io_uring_enter(), then go on with the next ones.
+ */
+ void xattr_batch_run(xattr_uring *ring, xattr_batch_op *ops, size_t count)
+{
+    struct io_uring_sqe *sqe;
+    unsigned tail, index, submitted, to_submit, done;
+    size_t i = 0, first, j;
+    int rv;
+
+    if (!ring || ring->broken) {
+        for (; i < count; i++) {
+            batch_sync(&ops[i]);
+        }
+        return;
+    }
+
+    while (i < count) {
+        first = i;
+        submitted = 0;
+        tail = *ring->sq_tail;
+        for (; i < count && submitted < ring->sq_entries; i++) {
+            index = tail & *ring->sq_mask;
+            sqe = &ring->sqes[index];
+            if (!uring_prep(ring, &ops[i], sqe)) {
+                batch_sync(&ops[i]);
+                continue;
+            }
+            sqe->user_data = i;
+            ops[i].err = EINPROGRESS;
+            XATTR_PROBE5(batch__submit, ops[i].opcode, ops[i].path, ops[i].fd, ops[i].name, ops[i].size);
+            ring->sq_array[index] = index;
+            tail++;
+            submitted++;
+        }
+        if (!submitted) {
+            continue;
+        }
+        __atomic_store_n(ring->sq_tail, tail, __ATOMIC_RELEASE);
+        if (xattr_stats_on) {
+            ring->submitted = xattr_stats_now();
+        }
+
+        to_submit = submitted;
+        done = 0;
+        while (done < submitted) {
+            rv = uring_enter(ring->fd, to_submit, submitted - done, IORING_ENTER_GETEVENTS);
+            if (rv < 0) {
+                /* ops in flight still write to their buffers, wait for them */
+                if (errno == EINTR || errno == EAGAIN || errno == EBUSY || to_submit < submitted) {
+                    uring_reap(ring, ops, &done);
+                    continue;
+                }
+                /* Whatever didn't complete is done the plain way from now on */
+                ring->broken = 1;
+                for (j = first; j < i; j++) {
+                    if (ops[j].err == EINPROGRESS) {
+                        batch_sync(&ops[j]);
+                    }
+                }
+                for (; i < count; i++) {
+                    batch_sync(&ops[i]);
+                }
+                return;
+            }
+            to_submit -= (unsigned) rv < to_submit ? (unsigned) rv : to_submit;
+            uring_reap(ring, ops, &done);
+        }
+    }
+}
+
+#else
+
+ xattr_uring *xattr_uring_open(unsigned entries)
+{
+    (void) entries;
+    errno = ENOSYS;
+    return NULL;
+}
+
+ void xattr_uring_close(xattr_uring *ring)
+{
+    (void) ring;
+}
+
+ void xattr_batch_run(xattr_uring *ring, xattr_batch_op *ops, size_t count)
+{
+    size_t i;
+
+    (void) ring;
+    for (i = 0; i < count; i++) {
+        batch_sync(&ops[i]);
+    }
+}
+
+#endif
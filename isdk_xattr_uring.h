@@ -0,0 +1,65 @@
+/*
+  Copyright (c) 2012 Riceball LEE(riceball.lee@gmail.com)
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+
+#ifndef isdk_xattr_uring__h
+ #define isdk_xattr_uring__h
+
+#include "isdk_xattr.h"
+#include <stddef.h>
+#include <sys/types.h>
+
+ #ifdef __cplusplus
+ extern "C"
+ {
+ #endif
+
+#define XATTR_BATCH_GET 0
+#define XATTR_BATCH_SET 1
+
+/* One request of a batch, by fd unless it's -1 and then by path */
+typedef struct xattr_batch_op {
+    int opcode;             /* XATTR_BATCH_GET or XATTR_BATCH_SET */
+    int fd;
+    const char *path;
+    const char *name;
+    void *value;
+    size_t size;
+    int options;            /* as for xattr_getxattr() and xattr_setxattr() */
+    ssize_t result;         /* length read, 0 once set or -1 */
+    int err;                /* errno when result is -1 */
+} xattr_batch_op;
+
+typedef struct xattr_uring xattr_uring;
+
+//an io_uring instance, NULL when the kernel can't do xattr ops through it:
+ xattr_uring *xattr_uring_open(unsigned entries);
+ void xattr_uring_close(xattr_uring *ring);
+
+//runs every op, through the ring if there's one, one call after the other otherwise:
+ void xattr_batch_run(xattr_uring *ring, xattr_batch_op *ops, size_t count);
+
+ #ifdef __cplusplus
+ }
+ #endif
+
+#endif
@@ -37,6 +37,8 @@ extern zend_module_entry xattr_module_entry;
 #endif
 
 PHP_MINIT_FUNCTION(xattr);
+PHP_MSHUTDOWN_FUNCTION(xattr);
+PHP_RSHUTDOWN_FUNCTION(xattr);
 PHP_MINFO_FUNCTION(xattr);
 
 PHP_FUNCTION(xattr_set);
@@ -44,6 +46,90 @@ PHP_FUNCTION(xattr_get);
 PHP_FUNCTION(xattr_remove);
 PHP_FUNCTION(xattr_list);
 PHP_FUNCTION(xattr_supported);
+PHP_FUNCTION(xattr_get_multi);
+PHP_FUNCTION(xattr_get_all);
+PHP_FUNCTION(xattr_set_multi);
+PHP_FUNCTION(xattr_bundle_get);
+PHP_FUNCTION(xattr_bundle_set);
+PHP_FUNCTION(xattr_get_int);
+PHP_FUNCTION(xattr_set_int);
+PHP_FUNCTION(xattr_get_float);
+PHP_FUNCTION(xattr_set_float);
+PHP_FUNCTION(xattr_incr);
+PHP_FUNCTION(xattr_cas);
+PHP_FUNCTION(xattr_get_packed);
+PHP_FUNCTION(xattr_fset);
+PHP_FUNCTION(xattr_fget);
+PHP_FUNCTION(xattr_fremove);
+PHP_FUNCTION(xattr_flist);
+PHP_FUNCTION(xattr_set_at);
+PHP_FUNCTION(xattr_get_at);
+PHP_FUNCTION(xattr_remove_at);
+PHP_FUNCTION(xattr_list_at);
+PHP_FUNCTION(xattr_get_paths);
+PHP_FUNCTION(xattr_scan);
+PHP_FUNCTION(xattr_scan_next);
+PHP_FUNCTION(xattr_scan_close);
+PHP_FUNCTION(xattr_flush);
+PHP_FUNCTION(xattr_stats);
+PHP_FUNCTION(xattr_stats_reset);
+PHP_FUNCTION(xattr_last_error);
+
+/* Calls of one function while xattr.stats is on */
+#define XATTR_STATS_FUNCTIONS	64
+
+typedef struct _php_xattr_call_count {
+	const char *name;
+	unsigned long calls;
+} php_xattr_call_count;
+
+ZEND_BEGIN_MODULE_GLOBALS(xattr)
+	zend_bool io_uring;		/* xattr.io_uring */
+	void *uring;			/* opened on first use */
+	zend_bool uring_failed;
+	zend_bool cache;		/* xattr.cache */
+	xattr_long_t cache_size;	/* xattr.cache_size */
+	HashTable *cache_table;	/* created on first use, dropped at the end of the request */
+	size_t cache_bytes;
+	unsigned long cache_hits;
+	unsigned long cache_misses;
+	xattr_long_t shm_size;		/* xattr.shm_size */
+	unsigned long shm_hits;
+	unsigned long shm_misses;
+	HashTable *basedir_table;	/* directories open_basedir allows */
+	HashTable *basedir_denied;	/* paths it was found not to allow */
+	char *basedir_for;		/* the open_basedir value they were checked against */
+	unsigned long basedir_hits;
+	unsigned long basedir_misses;
+	zend_bool write_behind;		/* xattr.write_behind */
+	HashTable *queue;		/* files with writes held back */
+	unsigned long queue_writes;
+	unsigned long queue_coalesced;
+	zend_bool compress;		/* xattr.compress */
+	xattr_long_t compress_threshold;	/* xattr.compress_threshold */
+	xattr_long_t chunk_size;	/* xattr.chunk_size, 0 to store every value in one piece */
+	zend_bool stats;		/* xattr.stats */
+	php_xattr_call_count stats_calls[XATTR_STATS_FUNCTIONS];
+	int stats_functions;
+	struct xattr_stats *stats_base;	/* the counters when this request began counting */
+	unsigned long stats_calls_base[XATTR_STATS_FUNCTIONS];
+	zend_bool stats_base_taken;
+	zend_bool quiet;		/* xattr.quiet */
+	zend_bool quiet_call;		/* no warnings from the running function */
+	int last_errno;			/* of the last failure, for xattr_last_error() */
+	const char *last_function;
+ZEND_END_MODULE_GLOBALS(xattr)
+
+#if PHP_MAJOR_VERSION >= 7
+#define XATTR_G(v) ZEND_MODULE_GLOBALS_ACCESSOR(xattr, v)
+#if defined(ZTS) && defined(COMPILE_DL_XATTR)
+ZEND_TSRMLS_CACHE_EXTERN()
+#endif
+#elif defined(ZTS)
+#define XATTR_G(v) TSRMG(xattr_globals_id, zend_xattr_globals *, v)
+#else
+#define XATTR_G(v) (xattr_globals.v)
+#endif
 
 #endif	/* PHP_XATTR_H */
 
@@ -0,0 +1,279 @@
+/*
+  +----------------------------------------------------------------------+
+  | PHP Version 5                                                        |
+  +----------------------------------------------------------------------+
+  | Copyright (c) 1997-2004 The PHP Group                                |
+  +----------------------------------------------------------------------+
+  | This source file is subject to version 3.0 of the PHP license,       |
+  | that is bundled with this package in the file LICENSE, and is        |
+  | available through the world-wide-web at the following url:           |
+  | http://www.php.net/license/3_0.txt.                                  |
+  | If you did not receive a copy of the PHP license and are unable to   |
+  | obtain it through the world-wide-web, please send a note to          |
+  | license@php.net so we can mail you a copy immediately.               |
+  +----------------------------------------------------------------------+
+*/
+
+/*
+ * Glue which lets xattr.c build against both the PHP 5 and the PHP 7/8
+ * engine. Only what the extension actually uses is covered here.
+ */
+
+#ifndef PHP_XATTR_COMPAT_H
+#define PHP_XATTR_COMPAT_H
+
+/* PHP 8 dropped the thread safe resource manager arguments entirely */
+#ifndef TSRMLS_CC
+#define TSRMLS_D	void
+#define TSRMLS_DC
+#define TSRMLS_C
+#define TSRMLS_CC
+#endif
+
+#if PHP_MAJOR_VERSION >= 7
+
+/* Types filled in by zend_parse_parameters() for "s" and "l" */
+typedef size_t		xattr_strlen_t;
+typedef zend_long	xattr_long_t;
+typedef zend_ulong	xattr_ulong_t;
+
+/*
+ * A string which is filled in by the kernel and then handed over to
+ * userland as it is. xattr_string_alloc() reserves len bytes plus the
+ * terminating NUL.
+ */
+typedef zend_string	xattr_string;
+
+#define xattr_string_alloc(len)			zend_string_alloc((len), 0)
+#define xattr_string_realloc(s, len)	zend_string_realloc((s), (len), 0)
+#define xattr_string_val(s)				ZSTR_VAL(s)
+#define xattr_string_free(s)			zend_string_free(s)
+
+#define XATTR_ASSOC_KEYLEN(len)			(len)
+
+#define xattr_add_assoc_stringl(arg, key, key_len, str, len) \
+	add_assoc_stringl_ex((arg), (key), XATTR_ASSOC_KEYLEN(key_len), (str), (len))
+#define xattr_add_next_index_stringl(arg, str, len) \
+	add_next_index_stringl((arg), (str), (len))
+
+#define xattr_stream_from_zval(stream, zv) \
+	php_stream_from_zval_no_verify((stream), (zv))
+
+#define XATTR_HASH_FOREACH_VAL(ht, entry)	ZEND_HASH_FOREACH_VAL((ht), (entry))
+#define XATTR_HASH_FOREACH_END()			ZEND_HASH_FOREACH_END()
+
+/* key is NULL for numeric keys, whose number goes to idx */
+#define XATTR_HASH_FOREACH_KEY_VAL(ht, idx, key, key_len, entry) { \
+	zend_string *_xattr_key; \
+	ZEND_HASH_FOREACH_KEY_VAL((ht), (idx), _xattr_key, (entry)) { \
+		key = _xattr_key ? ZSTR_VAL(_xattr_key) : NULL; \
+		key_len = _xattr_key ? ZSTR_LEN(_xattr_key) : 0;
+#define XATTR_HASH_FOREACH_KEY_END() \
+	} ZEND_HASH_FOREACH_END(); \
+}
+
+/* A string copy of an arbitrary zval */
+typedef zend_string	*xattr_tmp_string;
+
+#define xattr_tmp_string_init(t, zv)	(*(t) = zval_get_string(zv))
+#define xattr_tmp_string_val(t)			ZSTR_VAL(*(t))
+#define xattr_tmp_string_len(t)			ZSTR_LEN(*(t))
+#define xattr_tmp_string_free(t)		zend_string_release(*(t))
+
+/* {{{ xattr_zval_string
+ * Hand the len bytes of s over to zv without copying them
+ */
+static inline void xattr_zval_string(zval *zv, xattr_string *s, size_t len)
+{
+	ZSTR_LEN(s) = len;
+	ZSTR_VAL(s)[len] = '\0';
+	ZVAL_NEW_STR(zv, s);
+}
+/* }}} */
+
+static inline void xattr_add_assoc_string(zval *arg, const char *key, size_t key_len, xattr_string *s, size_t len)
+{
+	zval zv;
+
+	xattr_zval_string(&zv, s, len);
+	add_assoc_zval_ex(arg, key, XATTR_ASSOC_KEYLEN(key_len), &zv);
+}
+
+/* Resources */
+typedef zend_resource	xattr_resource;
+
+#define XATTR_RSRC_DTOR_FUNC(name)	static void name(zend_resource *rsrc)
+#define xattr_register_resource(zv, ptr, type) \
+	ZVAL_RES((zv), zend_register_resource((ptr), (type)))
+#define xattr_fetch_resource(zv, name, type) \
+	zend_fetch_resource(Z_RES_P(zv), (name), (type))
+#define xattr_close_resource(zv)	zend_list_close(Z_RES_P(zv))
+
+/* An array nested into another one, see xattr_zval_array_init() */
+#define XATTR_ZVAL_DECLARE(name)	zval name##_zv, *name = &name##_zv
+#define xattr_zval_array_init(zv)	array_init(zv)
+
+#define xattr_hash_str_find(ht, key, len)	zend_hash_str_find((ht), (key), (len))
+#define xattr_zval_get_long(zv)				zval_get_long(zv)
+
+#define XATTR_RETVAL_STRINGL(s, len)		RETVAL_STRINGL((s), (len))
+
+/* Hash tables of pointers to emalloc'ed memory, keys may be binary */
+#define XATTR_HASH_PTR_DTOR(name, func) \
+	static void name(zval *zv) { func(Z_PTR_P(zv)); }
+#define xattr_hash_find_ptr(ht, key, len)		zend_hash_str_find_ptr((ht), (key), (len))
+#define xattr_hash_update_ptr(ht, key, len, ptr)	zend_hash_str_update_ptr((ht), (key), (len), (ptr))
+#define xattr_hash_del(ht, key, len)			zend_hash_str_del((ht), (key), (len))
+#define xattr_hash_get_current_ptr(ht, pos)	zend_hash_get_current_data_ptr_ex((ht), (pos))
+
+#else
+
+typedef int			xattr_strlen_t;
+typedef long		xattr_long_t;
+typedef ulong		xattr_ulong_t;
+
+typedef char		xattr_string;
+
+#define xattr_string_alloc(len)			((char *) emalloc((len) + 1))
+#define xattr_string_realloc(s, len)	((char *) erealloc((s), (len) + 1))
+#define xattr_string_val(s)				(s)
+#define xattr_string_free(s)			efree(s)
+
+/* PHP 5 counts the terminating NUL of array keys */
+#define XATTR_ASSOC_KEYLEN(len)			((len) + 1)
+
+#define xattr_add_assoc_stringl(arg, key, key_len, str, len) \
+	add_assoc_stringl_ex((arg), (key), XATTR_ASSOC_KEYLEN(key_len), (char *) (str), (len), 1)
+#define xattr_add_next_index_stringl(arg, str, len) \
+	add_next_index_stringl((arg), (str), (len), 1)
+
+#define xattr_stream_from_zval(stream, zv) \
+	php_stream_from_zval_no_verify((stream), &(zv))
+
+#define XATTR_HASH_FOREACH_VAL(ht, entry) { \
+	HashPosition _xattr_pos; \
+	zval **_xattr_entry; \
+	for (zend_hash_internal_pointer_reset_ex((ht), &_xattr_pos); \
+		zend_hash_get_current_data_ex((ht), (void **) &_xattr_entry, &_xattr_pos) == SUCCESS; \
+		zend_hash_move_forward_ex((ht), &_xattr_pos)) { \
+		entry = *_xattr_entry;
+#define XATTR_HASH_FOREACH_END() \
+	} \
+}
+
+#define XATTR_HASH_FOREACH_KEY_VAL(ht, idx, key, key_len, entry) { \
+	HashPosition _xattr_pos; \
+	zval **_xattr_entry; \
+	char *_xattr_key; \
+	uint _xattr_key_len; \
+	ulong _xattr_idx; \
+	for (zend_hash_internal_pointer_reset_ex((ht), &_xattr_pos); \
+		zend_hash_get_current_data_ex((ht), (void **) &_xattr_entry, &_xattr_pos) == SUCCESS; \
+		zend_hash_move_forward_ex((ht), &_xattr_pos)) { \
+		if (zend_hash_get_current_key_ex((ht), &_xattr_key, &_xattr_key_len, &_xattr_idx, 0, &_xattr_pos) == HASH_KEY_IS_STRING) { \
+			key = _xattr_key; \
+			key_len = _xattr_key_len - 1; \
+		} else { \
+			key = NULL; \
+			key_len = 0; \
+			idx = _xattr_idx; \
+		} \
+		entry = *_xattr_entry;
+#define XATTR_HASH_FOREACH_KEY_END()	XATTR_HASH_FOREACH_END()
+
+typedef zval		xattr_tmp_string;
+
+#define xattr_tmp_string_init(t, zv)	do { *(t) = *(zv); zval_copy_ctor(t); convert_to_string(t); } while (0)
+#define xattr_tmp_string_val(t)			Z_STRVAL_P(t)
+#define xattr_tmp_string_len(t)			Z_STRLEN_P(t)
+#define xattr_tmp_string_free(t)		zval_dtor(t)
+
+static inline void xattr_zval_string(zval *zv, xattr_string *s, size_t len)
+{
+	s[len] = '\0';
+	ZVAL_STRINGL(zv, s, len, 0);
+}
+
+static inline void xattr_add_assoc_string(zval *arg, const char *key, size_t key_len, xattr_string *s, size_t len)
+{
+	s[len] = '\0';
+	add_assoc_stringl_ex(arg, (char *) key, XATTR_ASSOC_KEYLEN(key_len), s, len, 0);
+}
+
+typedef zend_rsrc_list_entry	xattr_resource;
+
+#define XATTR_RSRC_DTOR_FUNC(name)	static void name(zend_rsrc_list_entry *rsrc TSRMLS_DC)
+#define xattr_register_resource(zv, ptr, type) \
+	ZEND_REGISTER_RESOURCE((zv), (ptr), (type))
+#define xattr_fetch_resource(zv, name, type) \
+	zend_fetch_resource(&(zv) TSRMLS_CC, -1, (name), NULL, 1, (type))
+#define xattr_close_resource(zv)	zend_list_delete(Z_RESVAL_P(zv))
+
+#define XATTR_ZVAL_DECLARE(name)	zval *name
+#define xattr_zval_array_init(zv)	do { MAKE_STD_ZVAL(zv); array_init(zv); } while (0)
+
+static inline zval *xattr_hash_str_find(HashTable *ht, const char *key, size_t len)
+{
+	zval **entry;
+
+	if (zend_hash_find(ht, key, len + 1, (void **) &entry) == SUCCESS) {
+		return *entry;
+	}
+	return NULL;
+}
+
+static inline long xattr_zval_get_long(zval *zv)
+{
+	zval tmp = *zv;
+
+	zval_copy_ctor(&tmp);
+	convert_to_long(&tmp);
+	return Z_LVAL(tmp);
+}
+
+#define XATTR_RETVAL_STRINGL(s, len)		RETVAL_STRINGL((char *) (s), (len), 1)
+
+/* PHP 5 keys count their terminating NUL, so key must have one */
+#define XATTR_HASH_PTR_DTOR(name, func) \
+	static void name(void *data) { func(*(void **) data); }
+
+static inline void *xattr_hash_find_ptr(HashTable *ht, const char *key, size_t len)
+{
+	void **data;
+
+	if (zend_hash_find(ht, key, len + 1, (void **) &data) == SUCCESS) {
+		return *data;
+	}
+	return NULL;
+}
+
+static inline void xattr_hash_update_ptr(HashTable *ht, const char *key, size_t len, void *ptr)
+{
+	zend_hash_update(ht, key, len + 1, &ptr, sizeof(ptr), NULL);
+}
+
+#define xattr_hash_del(ht, key, len)			zend_hash_del((ht), (key), (len) + 1)
+
+static inline void *xattr_hash_get_current_ptr(HashTable *ht, HashPosition *pos)
+{
+	void **data;
+
+	if (zend_hash_get_current_data_ex(ht, (void **) &data, pos) == SUCCESS) {
+		return *data;
+	}
+	return NULL;
+}
+
+#endif
+
+#endif	/* PHP_XATTR_COMPAT_H */
+
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: noet sw=4 ts=4 fdm=marker
+ * vim<600: noet sw=4 ts=4
+ */
@@ -2,12 +2,20 @@
 Check write attr
 --SKIPIF--
 <?php
-  //if (!extension_loaded("xattr")) print "skip";
-  if (!xxattr_set("/Users/lixueyu/tmp", "user.key", "heee")) print "skip";
+if (!extension_loaded("xattr")) print "skip";
+$file = tempnam(sys_get_temp_dir(), "xattr");
+if (!@xattr_set($file, "user.php_test", "1")) print "skip user xattrs not supported";
+unlink($file);
 ?>
 --FILE--
-<?php 
-echo "xattr extension is available";
+<?php
+$file = tempnam(sys_get_temp_dir(), "xattr");
+var_dump(xattr_set($file, "user.key", "heee"));
+var_dump(xattr_get($file, "user.key"));
+var_dump(xattr_remove($file, "user.key"));
+unlink($file);
 ?>
 --EXPECT--
-xattr extension is available
+bool(true)
+string(4) "heee"
+bool(true)
@@ -0,0 +1,28 @@
+--TEST--
+Check xattr_get_multi()
+--SKIPIF--
+<?php
+if (!extension_loaded("xattr")) print "skip";
+$file = tempnam(sys_get_temp_dir(), "xattr");
+if (!@xattr_set($file, "user.php_test", "1")) print "skip user xattrs not supported";
+unlink($file);
+?>
+--FILE--
+<?php
+$file = tempnam(sys_get_temp_dir(), "xattr");
+xattr_set($file, "user.a", "first");
+xattr_set($file, "user.b", "");
+var_dump(xattr_get_multi($file, array("user.a", "user.b", "user.missing")));
+var_dump(@xattr_get_multi($file . ".nonexistent", array("user.a")));
+unlink($file);
+?>
+--EXPECT--
+array(3) {
+  ["user.a"]=>
+  string(5) "first"
+  ["user.b"]=>
+  string(0) ""
+  ["user.missing"]=>
+  bool(false)
+}
+bool(false)
@@ -0,0 +1,36 @@
+--TEST--
+Check xattr_get_all()
+--SKIPIF--
+<?php
+if (!extension_loaded("xattr")) print "skip";
+$file = tempnam(sys_get_temp_dir(), "xattr");
+if (!@xattr_set($file, "user.php_test", "1")) print "skip user xattrs not supported";
+unlink($file);
+?>
+--FILE--
+<?php
+$file = tempnam(sys_get_temp_dir(), "xattr");
+xattr_set($file, "user.app.a", "first");
+xattr_set($file, "user.app.b", "second");
+xattr_set($file, "user.other", "third");
+$all = xattr_get_all($file, "user.");
+ksort($all);
+var_dump($all);
+var_dump(xattr_get_all($file, "user.app."));
+unlink($file);
+?>
+--EXPECTF--
+array(3) {
+  ["user.app.a"]=>
+  string(5) "first"
+  ["user.app.b"]=>
+  string(6) "second"
+  ["user.other"]=>
+  string(5) "third"
+}
+array(2) {
+  ["user.app.%c"]=>
+  string(%d) "%s"
+  ["user.app.%c"]=>
+  string(%d) "%s"
+}
@@ -0,0 +1,31 @@
+--TEST--
+Check xattr_get() and xattr_list() on small and large values
+--SKIPIF--
+<?php
+if (!extension_loaded("xattr")) print "skip";
+$file = tempnam(sys_get_temp_dir(), "xattr");
+if (!@xattr_set($file, "user.php_test", "1")) print "skip user xattrs not supported";
+unlink($file);
+?>
+--FILE--
+<?php
+$file = tempnam(sys_get_temp_dir(), "xattr");
+$large = str_repeat("0123456789abcdef", 256);
+xattr_set($file, "user.small", "value");
+xattr_set($file, "user.large", $large);
+var_dump(xattr_get($file, "user.small"));
+var_dump(xattr_get($file, "user.large") === $large);
+$names = array_values(preg_grep('/^user\./', xattr_list($file)));
+sort($names);
+var_dump($names);
+unlink($file);
+?>
+--EXPECT--
+string(5) "value"
+bool(true)
+array(2) {
+  [0]=>
+  string(10) "user.large"
+  [1]=>
+  string(10) "user.small"
+}
@@ -0,0 +1,31 @@
+--TEST--
+Check xattr_fset(), xattr_fget(), xattr_flist() and xattr_fremove() on streams
+--SKIPIF--
+<?php
+if (!extension_loaded("xattr")) print "skip";
+$file = tempnam(sys_get_temp_dir(), "xattr");
+if (!@xattr_set($file, "user.php_test", "1")) print "skip user xattrs not supported";
+unlink($file);
+?>
+--FILE--
+<?php
+$file = tempnam(sys_get_temp_dir(), "xattr");
+$fp = fopen($file, "r");
+var_dump(xattr_fset($fp, "user.stream", "value"));
+var_dump(@xattr_fset($fp, "user.stream", "other", XXATTR_XATTR_CREATE));
+var_dump(xattr_fget($fp, "user.stream"));
+var_dump(xattr_get($file, "user.stream"));
+var_dump(in_array("user.stream", xattr_flist($fp)));
+var_dump(xattr_fremove($fp, "user.stream"));
+var_dump(in_array("user.stream", xattr_flist($fp)));
+fclose($fp);
+unlink($file);
+?>
+--EXPECT--
+bool(true)
+bool(false)
+string(5) "value"
+string(5) "value"
+bool(true)
+bool(true)
+bool(false)
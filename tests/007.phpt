@@ -0,0 +1,34 @@
+--TEST--
+Check xattr_*_at() relative to an open directory
+--SKIPIF--
+<?php
+if (!extension_loaded("xattr")) print "skip";
+$file = tempnam(sys_get_temp_dir(), "xattr");
+if (!@xattr_set($file, "user.php_test", "1")) print "skip user xattrs not supported";
+unlink($file);
+?>
+--FILE--
+<?php
+$dir = sys_get_temp_dir() . "/xattr_at_" . getmypid();
+mkdir($dir);
+touch("$dir/file");
+$dh = opendir($dir);
+var_dump(xattr_set_at($dh, "file", "user.at", "value"));
+var_dump(xattr_get_at($dh, "file", "user.at"));
+var_dump(xattr_get("$dir/file", "user.at"));
+var_dump(in_array("user.at", xattr_list_at($dh, "file")));
+var_dump(xattr_remove_at($dh, "file", "user.at"));
+var_dump(@xattr_get_at($dh, "file", "user.at"));
+var_dump(@xattr_get_at($dh, "../file", "user.at"));
+closedir($dh);
+unlink("$dir/file");
+rmdir($dir);
+?>
+--EXPECT--
+bool(true)
+string(5) "value"
+string(5) "value"
+bool(true)
+bool(true)
+bool(false)
+bool(false)
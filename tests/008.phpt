@@ -0,0 +1,88 @@
+--TEST--
+Check xattr_scan() walking a directory tree
+--SKIPIF--
+<?php
+if (!extension_loaded("xattr")) print "skip";
+$file = tempnam(sys_get_temp_dir(), "xattr");
+if (!@xattr_set($file, "user.php_test", "1")) print "skip user xattrs not supported";
+unlink($file);
+?>
+--FILE--
+<?php
+$dir = sys_get_temp_dir() . "/xattr_scan_" . getmypid();
+mkdir("$dir/a/b", 0777, true);
+touch("$dir/f");
+touch("$dir/a/b/g");
+xattr_set("$dir/f", "user.one", "1");
+xattr_set("$dir/f", "user.two", str_repeat("x", 3000));
+xattr_set("$dir/a/b", "user.dir", "d");
+xattr_set("$dir/a/b/g", "user.deep", "g");
+
+function scan($dir, $options) {
+	$result = array();
+	$scan = xattr_scan($dir, $options);
+	while (list($path, $attrs) = xattr_scan_next($scan)) {
+		ksort($attrs);
+		$result[$path] = array_map("strlen", $attrs);
+	}
+	xattr_scan_close($scan);
+	ksort($result);
+	return $result;
+}
+
+print_r(scan($dir, array("prefix" => "user.")));
+print_r(scan("$dir/", array("prefix" => "user.t", "skip_empty" => true)));
+print_r(scan($dir, array("prefix" => "user.", "depth" => 1, "skip_empty" => true)));
+
+unlink("$dir/a/b/g");
+rmdir("$dir/a/b");
+rmdir("$dir/a");
+unlink("$dir/f");
+rmdir($dir);
+?>
+--EXPECT--
+Array
+(
+    [a] => Array
+        (
+        )
+
+    [a/b] => Array
+        (
+            [user.dir] => 1
+        )
+
+    [a/b/g] => Array
+        (
+            [user.deep] => 1
+        )
+
+    [f] => Array
+        (
+            [user.one] => 1
+            [user.two] => 3000
+        )
+
+)
+Array
+(
+    [f] => Array
+        (
+            [user.two] => 3000
+        )
+
+)
+Array
+(
+    [a/b] => Array
+        (
+            [user.dir] => 1
+        )
+
+    [f] => Array
+        (
+            [user.one] => 1
+            [user.two] => 3000
+        )
+
+)
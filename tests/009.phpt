@@ -0,0 +1,64 @@
+--TEST--
+Check xattr_scan() with worker threads
+--SKIPIF--
+<?php
+if (!extension_loaded("xattr")) print "skip";
+$file = tempnam(sys_get_temp_dir(), "xattr");
+if (!@xattr_set($file, "user.php_test", "1")) print "skip user xattrs not supported";
+unlink($file);
+?>
+--FILE--
+<?php
+$dir = sys_get_temp_dir() . "/xattr_scan_threads_" . getmypid();
+mkdir($dir);
+for ($i = 0; $i < 8; $i++) {
+	mkdir("$dir/d$i/sub", 0777, true);
+	for ($j = 0; $j < 8; $j++) {
+		touch("$dir/d$i/sub/f$j");
+		xattr_set("$dir/d$i/sub/f$j", "user.id", "$i.$j");
+	}
+}
+
+function scan($dir, $options) {
+	$result = array();
+	$scan = xattr_scan($dir, $options);
+	while (list($path, $attrs) = xattr_scan_next($scan)) {
+		$result[$path] = $attrs;
+	}
+	xattr_scan_close($scan);
+	ksort($result);
+	return $result;
+}
+
+$expected = scan($dir, array("prefix" => "user."));
+var_dump(count($expected));
+var_dump($expected["d3/sub/f5"]);
+var_dump(scan($dir, array("prefix" => "user.", "threads" => 4)) === $expected);
+var_dump(scan($dir, array("prefix" => "user.", "threads" => 1)) === $expected);
+var_dump(count(scan($dir, array("depth" => 1, "threads" => 3))));
+
+/* Closing in the middle of a walk stops the workers */
+$scan = xattr_scan($dir, array("threads" => 2));
+var_dump(is_array(xattr_scan_next($scan)));
+var_dump(xattr_scan_close($scan));
+
+for ($i = 0; $i < 8; $i++) {
+	for ($j = 0; $j < 8; $j++) {
+		unlink("$dir/d$i/sub/f$j");
+	}
+	rmdir("$dir/d$i/sub");
+	rmdir("$dir/d$i");
+}
+rmdir($dir);
+?>
+--EXPECT--
+int(80)
+array(1) {
+  ["user.id"]=>
+  string(3) "3.5"
+}
+bool(true)
+bool(true)
+int(16)
+bool(true)
+bool(true)
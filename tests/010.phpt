@@ -0,0 +1,44 @@
+--TEST--
+Check batched reads with xattr.io_uring enabled
+--SKIPIF--
+<?php
+if (!extension_loaded("xattr")) print "skip";
+$file = tempnam(sys_get_temp_dir(), "xattr");
+if (!@xattr_set($file, "user.php_test", "1")) print "skip user xattrs not supported";
+unlink($file);
+?>
+--INI--
+xattr.io_uring=1
+--FILE--
+<?php
+$file = tempnam(sys_get_temp_dir(), "xattr");
+$names = array();
+for ($i = 0; $i < 20; $i++) {
+	xattr_set($file, "user.k$i", str_repeat("v", $i * 100));
+	$names[] = "user.k$i";
+}
+$names[] = "user.missing";
+
+/* Works the same whether the kernel can do it through io_uring or not */
+$values = $batched = xattr_get_multi($file, $names);
+var_dump(count($values));
+var_dump(strlen($values["user.k3"]), strlen($values["user.k19"]));
+var_dump($values["user.missing"]);
+
+$all = xattr_get_all($file, "user.k");
+ksort($values);
+ksort($all);
+unset($values["user.missing"]);
+var_dump($all === $values);
+
+ini_set("xattr.io_uring", 0);
+var_dump(xattr_get_multi($file, $names) === $batched);
+unlink($file);
+?>
+--EXPECT--
+int(21)
+int(300)
+int(1900)
+bool(false)
+bool(true)
+bool(true)
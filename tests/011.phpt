@@ -0,0 +1,71 @@
+--TEST--
+Check xattr_get_paths() reading attributes of many files
+--SKIPIF--
+<?php
+if (!extension_loaded("xattr")) print "skip";
+$file = tempnam(sys_get_temp_dir(), "xattr");
+if (!@xattr_set($file, "user.php_test", "1")) print "skip user xattrs not supported";
+unlink($file);
+?>
+--FILE--
+<?php
+$dir = sys_get_temp_dir() . "/xattr_paths_" . getmypid();
+mkdir($dir);
+$paths = array();
+for ($i = 0; $i < 3; $i++) {
+	touch("$dir/f$i");
+	xattr_set("$dir/f$i", "user.checksum", "sum$i");
+	$paths[] = "$dir/f$i";
+}
+xattr_set("$dir/f1", "user.owner", "bob");
+$paths[] = "$dir/missing";
+
+$result = xattr_get_paths($paths, "user.checksum");
+var_dump(array_keys($result) === $paths);
+var_dump(array_values($result));
+
+$result = xattr_get_paths($paths, array("user.checksum", "user.owner"));
+var_dump(array_values($result));
+
+foreach ($paths as $path) {
+	@unlink($path);
+}
+rmdir($dir);
+?>
+--EXPECT--
+bool(true)
+array(4) {
+  [0]=>
+  string(4) "sum0"
+  [1]=>
+  string(4) "sum1"
+  [2]=>
+  string(4) "sum2"
+  [3]=>
+  bool(false)
+}
+array(4) {
+  [0]=>
+  array(2) {
+    ["user.checksum"]=>
+    string(4) "sum0"
+    ["user.owner"]=>
+    bool(false)
+  }
+  [1]=>
+  array(2) {
+    ["user.checksum"]=>
+    string(4) "sum1"
+    ["user.owner"]=>
+    string(3) "bob"
+  }
+  [2]=>
+  array(2) {
+    ["user.checksum"]=>
+    string(4) "sum2"
+    ["user.owner"]=>
+    bool(false)
+  }
+  [3]=>
+  bool(false)
+}
@@ -0,0 +1,58 @@
+--TEST--
+Check the request cache of xattr_get() and xattr_list()
+--SKIPIF--
+<?php
+if (!extension_loaded("xattr")) print "skip";
+$file = tempnam(sys_get_temp_dir(), "xattr");
+if (!@xattr_set($file, "user.php_test", "1")) print "skip user xattrs not supported";
+unlink($file);
+?>
+--INI--
+xattr.cache=1
+--FILE--
+<?php
+$file = tempnam(sys_get_temp_dir(), "xattr");
+xattr_set($file, "user.a", "first");
+/* Files changed within the last couple of seconds are not cached */
+sleep(3);
+
+$before = xattr_stats();
+var_dump(xattr_get($file, "user.a"));
+var_dump(xattr_get($file, "user.a"));
+var_dump(@xattr_get($file, "user.missing"));
+var_dump(@xattr_get($file, "user.missing"));
+$list = xattr_list($file);
+var_dump(in_array("user.a", $list), xattr_list($file) === $list);
+$after = xattr_stats();
+var_dump($after["cache_hits"] - $before["cache_hits"]);
+var_dump($after["cache_misses"] - $before["cache_misses"]);
+var_dump($after["cache_entries"]);
+
+/* Writes are seen right away */
+xattr_set($file, "user.a", "second");
+xattr_set($file, "user.b", "other");
+var_dump(xattr_get($file, "user.a"));
+var_dump(in_array("user.b", xattr_list($file)));
+xattr_remove($file, "user.a");
+var_dump(@xattr_get($file, "user.a"));
+
+$fp = fopen($file, "r");
+xattr_fset($fp, "user.a", "third");
+var_dump(xattr_get($file, "user.a"));
+fclose($fp);
+unlink($file);
+?>
+--EXPECT--
+string(5) "first"
+string(5) "first"
+bool(false)
+bool(false)
+bool(true)
+bool(true)
+int(3)
+int(3)
+int(3)
+string(6) "second"
+bool(true)
+bool(false)
+string(5) "third"
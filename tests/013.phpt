@@ -0,0 +1,51 @@
+--TEST--
+Check the shared cache set up by xattr.shm_size
+--SKIPIF--
+<?php
+if (!extension_loaded("xattr")) print "skip";
+$file = tempnam(sys_get_temp_dir(), "xattr");
+if (!@xattr_set($file, "user.php_test", "1")) print "skip user xattrs not supported";
+unlink($file);
+$stats = xattr_stats();
+if (!$stats["shm_slots"]) print "skip no shared memory";
+?>
+--INI--
+xattr.shm_size=1M
+--FILE--
+<?php
+$file = tempnam(sys_get_temp_dir(), "xattr");
+xattr_set($file, "user.a", "first");
+/* Files changed within the last couple of seconds are not cached */
+sleep(3);
+
+$before = xattr_stats();
+var_dump(xattr_get($file, "user.a"));
+var_dump(xattr_get($file, "user.a"));
+var_dump(@xattr_get($file, "user.missing"));
+var_dump(@xattr_get($file, "user.missing"));
+$list = xattr_list($file);
+var_dump(in_array("user.a", $list), xattr_list($file) === $list);
+$after = xattr_stats();
+var_dump($after["shm_hits"] - $before["shm_hits"]);
+var_dump($after["shm_misses"] - $before["shm_misses"]);
+
+/* Writes are seen right away */
+xattr_set($file, "user.a", "second");
+var_dump(xattr_get($file, "user.a"));
+xattr_remove($file, "user.a");
+var_dump(@xattr_get($file, "user.a"));
+var_dump(in_array("user.a", xattr_list($file)));
+unlink($file);
+?>
+--EXPECT--
+string(5) "first"
+string(5) "first"
+bool(false)
+bool(false)
+bool(true)
+bool(true)
+int(3)
+int(3)
+string(6) "second"
+bool(false)
+bool(false)
@@ -0,0 +1,67 @@
+--TEST--
+Check open_basedir decisions remembered per directory and denied path
+--SKIPIF--
+<?php
+if (!extension_loaded("xattr")) print "skip";
+$file = tempnam(sys_get_temp_dir(), "xattr");
+if (!@xattr_set($file, "user.php_test", "1")) print "skip user xattrs not supported";
+unlink($file);
+?>
+--FILE--
+<?php
+$dir = realpath(sys_get_temp_dir()) . "/xattr_basedir_014";
+mkdir("$dir/inner", 0777, true);
+$files = array();
+for ($i = 0; $i < 5; $i++) {
+	$files[] = $file = "$dir/inner/f$i";
+	touch($file);
+	xattr_set($file, "user.a", "v$i");
+}
+symlink(__FILE__, "$dir/inner/link");
+
+ini_set("open_basedir", $dir);
+$before = xattr_stats();
+foreach ($files as $file) {
+	xattr_get($file, "user.a");
+}
+$after = xattr_stats();
+var_dump($after["basedir_misses"] - $before["basedir_misses"]);
+var_dump($after["basedir_hits"] - $before["basedir_hits"]);
+
+/* A symlink in an allowed directory still gets the full check */
+var_dump(@xattr_get("$dir/inner/link", "user.a"));
+var_dump(count(xattr_get_paths($files, "user.a")));
+
+/* Narrowing open_basedir is seen right away */
+ini_set("open_basedir", "$dir/elsewhere");
+var_dump(@xattr_get($files[0], "user.a"));
+$paths = @xattr_get_paths($files, "user.a");
+var_dump($paths[$files[1]]);
+
+/* Denied paths are remembered too */
+$before = xattr_stats();
+var_dump(@xattr_get($files[0], "user.a"));
+$after = xattr_stats();
+var_dump($after["basedir_misses"] - $before["basedir_misses"]);
+var_dump($after["basedir_hits"] - $before["basedir_hits"]);
+?>
+--CLEAN--
+<?php
+$dir = realpath(sys_get_temp_dir()) . "/xattr_basedir_014";
+@unlink("$dir/inner/link");
+for ($i = 0; $i < 5; $i++) {
+	@unlink("$dir/inner/f$i");
+}
+@rmdir("$dir/inner");
+@rmdir($dir);
+?>
+--EXPECT--
+int(1)
+int(4)
+bool(false)
+int(5)
+bool(false)
+bool(false)
+bool(false)
+int(0)
+int(1)
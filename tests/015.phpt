@@ -0,0 +1,67 @@
+--TEST--
+Check xattr_set_multi() with per key flags and rollback
+--SKIPIF--
+<?php
+if (!extension_loaded("xattr")) print "skip";
+$file = tempnam(sys_get_temp_dir(), "xattr");
+if (!@xattr_set($file, "user.php_test", "1")) print "skip user xattrs not supported";
+unlink($file);
+?>
+--FILE--
+<?php
+$file = tempnam(sys_get_temp_dir(), "xattr");
+xattr_set($file, "user.old", "before");
+
+var_dump(xattr_set_multi($file, array("user.a" => "1", "user.b" => 2, "user.old" => "after")));
+var_dump(xattr_get_multi($file, array("user.a", "user.b", "user.old")));
+
+/* user.a exists, so creating it fails but the others are still set */
+$status = xattr_set_multi($file, array("user.c" => "3", "user.a" => "x", "user.d" => "4"), 0,
+	array("user.a" => XXATTR_XATTR_CREATE));
+var_dump($status["user.c"], $status["user.a"], $status["user.d"]);
+var_dump(xattr_get($file, "user.a"));
+
+/* With XATTR_ROLLBACK a failure undoes everything written before it */
+$status = xattr_set_multi($file, array("user.old" => "changed", "user.e" => "5", "user.missing" => "6", "user.f" => "7"),
+	XATTR_ROLLBACK, array("user.missing" => XXATTR_XATTR_REPLACE));
+var_dump(array_values($status));
+var_dump(xattr_get($file, "user.old"));
+var_dump(@xattr_get($file, "user.e"), @xattr_get($file, "user.f"));
+
+var_dump(@xattr_set_multi("/nonexistent/xattr", array("user.a" => "1")));
+unlink($file);
+?>
+--EXPECT--
+array(3) {
+  ["user.a"]=>
+  bool(true)
+  ["user.b"]=>
+  bool(true)
+  ["user.old"]=>
+  bool(true)
+}
+array(3) {
+  ["user.a"]=>
+  string(1) "1"
+  ["user.b"]=>
+  string(1) "2"
+  ["user.old"]=>
+  string(5) "after"
+}
+bool(true)
+bool(false)
+bool(true)
+string(1) "1"
+array(4) {
+  [0]=>
+  bool(false)
+  [1]=>
+  bool(false)
+  [2]=>
+  bool(false)
+  [3]=>
+  bool(false)
+}
+string(5) "after"
+bool(false)
+bool(false)
@@ -0,0 +1,61 @@
+--TEST--
+Check writes held back by xattr.write_behind
+--SKIPIF--
+<?php
+if (!extension_loaded("xattr")) print "skip";
+$file = tempnam(sys_get_temp_dir(), "xattr");
+if (!@xattr_set($file, "user.php_test", "1")) print "skip user xattrs not supported";
+unlink($file);
+?>
+--INI--
+xattr.write_behind=1
+--FILE--
+<?php
+$file = tempnam(sys_get_temp_dir(), "xattr");
+$copy = tempnam(sys_get_temp_dir(), "xattr");
+
+$before = xattr_stats();
+for ($i = 1; $i <= 100; $i++) {
+	xattr_set($file, "user.hits", (string) $i);
+}
+xattr_set($copy, "user.hits", "x");
+$after = xattr_stats();
+var_dump($after["queued_writes"] - $before["queued_writes"]);
+var_dump($after["coalesced_writes"] - $before["coalesced_writes"]);
+
+/* A descriptor could be any file, so everything is written out first */
+$fp = fopen($copy, "r");
+var_dump(@xattr_fget($fp, "user.hits"));
+fclose($fp);
+
+/* Reading the same path writes it out first */
+var_dump(xattr_get($file, "user.hits"));
+var_dump(xattr_flush());
+var_dump(xattr_get($copy, "user.hits"));
+
+/* CREATE and REPLACE are never held back */
+var_dump(@xattr_set($file, "user.hits", "again", XXATTR_XATTR_CREATE));
+
+xattr_set($file, "user.last", "1");
+var_dump(xattr_flush($file));
+var_dump(xattr_get($file, "user.last"));
+
+/* Failures only show up when flushing */
+var_dump(xattr_set("/nonexistent/xattr", "user.a", "1"));
+var_dump(@xattr_flush());
+
+unlink($file);
+unlink($copy);
+?>
+--EXPECT--
+int(101)
+int(99)
+string(1) "x"
+string(3) "100"
+bool(true)
+string(1) "x"
+bool(false)
+bool(true)
+string(1) "1"
+bool(true)
+bool(false)
@@ -0,0 +1,50 @@
+--TEST--
+Check fields packed into one attribute with xattr_bundle_set() and xattr_bundle_get()
+--SKIPIF--
+<?php
+if (!extension_loaded("xattr")) print "skip";
+$file = tempnam(sys_get_temp_dir(), "xattr");
+if (!@xattr_set($file, "user.php_test", "1")) print "skip user xattrs not supported";
+unlink($file);
+?>
+--FILE--
+<?php
+$file = tempnam(sys_get_temp_dir(), "xattr");
+
+var_dump(xattr_bundle_set($file, "user.meta", array("owner" => "alice", "size" => 1024, "tag" => "")));
+var_dump(xattr_bundle_set($file, "user.meta", array("size" => 2048, "tag" => null, "mime" => "text/plain")));
+var_dump(xattr_bundle_get($file, "user.meta", "size"));
+var_dump(xattr_bundle_get($file, "user.meta", "tag"));
+var_dump(xattr_bundle_get($file, "user.meta"));
+
+/* One attribute holds it all */
+var_dump(in_array("user.meta", xattr_list($file)), count(xattr_list($file)) <= 2);
+
+xattr_set($file, "user.plain", "not a bundle");
+var_dump(@xattr_bundle_get($file, "user.plain", "size"));
+var_dump(@xattr_bundle_get($file, "user.missing"));
+
+/* Removing every field removes the attribute */
+var_dump(xattr_bundle_set($file, "user.meta", array("owner" => null, "size" => null, "mime" => null)));
+var_dump(@xattr_get($file, "user.meta"));
+unlink($file);
+?>
+--EXPECT--
+bool(true)
+bool(true)
+string(4) "2048"
+bool(false)
+array(3) {
+  ["mime"]=>
+  string(10) "text/plain"
+  ["owner"]=>
+  string(5) "alice"
+  ["size"]=>
+  string(4) "2048"
+}
+bool(true)
+bool(true)
+bool(false)
+bool(false)
+bool(true)
+bool(false)
@@ -0,0 +1,47 @@
+--TEST--
+Check values compressed with xattr.compress
+--SKIPIF--
+<?php
+if (!extension_loaded("xattr")) print "skip";
+$file = tempnam(sys_get_temp_dir(), "xattr");
+if (!@xattr_set($file, "user.php_test", "1")) print "skip user xattrs not supported";
+unlink($file);
+ob_start();
+phpinfo(INFO_MODULES);
+if (strpos(ob_get_clean(), "Compression => unavailable") !== false) print "skip built without zlib";
+?>
+--INI--
+xattr.compress=1
+xattr.compress_threshold=100
+--FILE--
+<?php
+$file = tempnam(sys_get_temp_dir(), "xattr");
+$json = json_encode(array_fill(0, 200, array("id" => 1, "name" => "something")));
+
+var_dump(xattr_set($file, "user.big", $json));
+var_dump(xattr_set($file, "user.small", "short"));
+var_dump(xattr_get($file, "user.big") === $json);
+var_dump(xattr_get($file, "user.small"));
+$all = xattr_get_multi($file, array("user.big", "user.small"));
+var_dump($all["user.big"] === $json);
+
+/* Compressed values still read back once compression is off */
+ini_set("xattr.compress", 0);
+var_dump(xattr_get($file, "user.big") === $json);
+var_dump(xattr_get($file, "user.small"));
+
+/* Values that happen to look compressed are left alone */
+ini_set("xattr.compress", 1);
+xattr_set($file, "user.odd", "\0XZ\1garbage");
+var_dump(xattr_get($file, "user.odd") === "\0XZ\1garbage");
+unlink($file);
+?>
+--EXPECT--
+bool(true)
+bool(true)
+bool(true)
+string(5) "short"
+bool(true)
+bool(true)
+string(5) "short"
+bool(true)
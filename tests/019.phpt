@@ -0,0 +1,72 @@
+--TEST--
+Check typed accessors xattr_get_int(), xattr_incr() and xattr_get_packed()
+--SKIPIF--
+<?php
+if (!extension_loaded("xattr")) print "skip";
+$file = tempnam(sys_get_temp_dir(), "xattr");
+if (!@xattr_set($file, "user.php_test", "1")) print "skip user xattrs not supported";
+unlink($file);
+?>
+--FILE--
+<?php
+$file = tempnam(sys_get_temp_dir(), "xattr");
+
+var_dump(xattr_set_int($file, "user.n", -2));
+var_dump(xattr_get($file, "user.n") === pack("P", -2));
+var_dump(xattr_get_int($file, "user.n"));
+
+/* A missing attribute counts as 0 */
+var_dump(xattr_incr($file, "user.count"));
+var_dump(xattr_incr($file, "user.count", 10));
+var_dump(xattr_incr($file, "user.count", -3));
+var_dump(xattr_get_int($file, "user.count"));
+
+var_dump(xattr_set_float($file, "user.f", 1.5));
+var_dump(xattr_get_float($file, "user.f"));
+
+/* Only 8 byte values are numbers */
+xattr_set($file, "user.s", "abc");
+var_dump(@xattr_get_int($file, "user.s"));
+var_dump(@xattr_incr($file, "user.s"));
+var_dump(xattr_get($file, "user.s"));
+
+xattr_set($file, "user.p", pack("VvxCce", 100000, 513, 7, 255, 0.25));
+var_dump(xattr_get_packed($file, "user.p", "Vcount/vport/x/Cflags/csigned/eavg"));
+var_dump(@xattr_get_packed($file, "user.p", "Vcount/Pmore/Pmissing"));
+/* Empty fields are skipped */
+var_dump(xattr_get_packed($file, "user.p", "Vcount//vport/"));
+
+unlink($file);
+?>
+--EXPECT--
+bool(true)
+bool(true)
+int(-2)
+int(1)
+int(11)
+int(8)
+int(8)
+bool(true)
+float(1.5)
+bool(false)
+bool(false)
+string(3) "abc"
+array(5) {
+  ["count"]=>
+  int(100000)
+  ["port"]=>
+  int(513)
+  ["flags"]=>
+  int(7)
+  ["signed"]=>
+  int(-1)
+  ["avg"]=>
+  float(0.25)
+}
+bool(false)
+array(2) {
+  ["count"]=>
+  int(100000)
+  ["port"]=>
+  int(513)
+}
@@ -0,0 +1,51 @@
+--TEST--
+Check xattr_cas() and concurrent xattr_incr()
+--SKIPIF--
+<?php
+if (!extension_loaded("xattr")) print "skip";
+$file = tempnam(sys_get_temp_dir(), "xattr");
+if (!@xattr_set($file, "user.php_test", "1")) print "skip user xattrs not supported";
+unlink($file);
+?>
+--FILE--
+<?php
+$file = tempnam(sys_get_temp_dir(), "xattr");
+
+/* null expects the attribute to be missing */
+var_dump(xattr_cas($file, "user.v", null, "one"));
+var_dump(xattr_cas($file, "user.v", null, "two"));
+var_dump(xattr_cas($file, "user.v", "two", "three"));
+var_dump(xattr_cas($file, "user.v", "one", "three"));
+var_dump(xattr_get($file, "user.v"));
+
+/* Workers incrementing the same counter must not lose updates */
+$workers = function_exists("pcntl_fork") ? 4 : 1;
+$pids = array();
+for ($i = 0; $i < $workers; $i++) {
+	$pid = $workers > 1 ? pcntl_fork() : 0;
+	if ($pid === 0) {
+		for ($j = 0; $j < 4000 / $workers; $j++) {
+			xattr_incr($file, "user.count");
+		}
+		if ($workers > 1) {
+			exit(0);
+		}
+	}
+	$pids[] = $pid;
+}
+if ($workers > 1) {
+	foreach ($pids as $pid) {
+		pcntl_waitpid($pid, $status);
+	}
+}
+var_dump(xattr_get_int($file, "user.count"));
+
+unlink($file);
+?>
+--EXPECT--
+bool(true)
+bool(false)
+bool(false)
+bool(true)
+string(5) "three"
+int(4000)
@@ -0,0 +1,113 @@
+--TEST--
+Check values split into chunks with xattr.chunk_size
+--SKIPIF--
+<?php
+if (!extension_loaded("xattr")) print "skip";
+$file = tempnam(sys_get_temp_dir(), "xattr");
+if (!@xattr_set($file, "user.php_test", "1")) print "skip user xattrs not supported";
+unlink($file);
+?>
+--INI--
+xattr.chunk_size=100
+xattr.compress=0
+--FILE--
+<?php
+$file = tempnam(sys_get_temp_dir(), "xattr");
+$big = str_repeat("0123456789", 95);
+
+var_dump(xattr_set($file, "user.big", $big));
+var_dump(strlen(xattr_get($file, "user.big.0")), strlen(xattr_get($file, "user.big.9")), @xattr_get($file, "user.big.10"));
+
+/* The chunks stay out of sight */
+var_dump(array_values(preg_grep('/^user\./', xattr_list($file))) == array("user.big"));
+var_dump(array_keys(xattr_get_all($file, "user.")) == array("user.big"));
+var_dump(strlen(xattr_get($file, "user.big")));
+var_dump(xattr_get($file, "user.big") === $big);
+var_dump(xattr_get_multi($file, array("user.big")) === array("user.big" => $big));
+
+$fp = fopen($file, "r");
+var_dump(xattr_fget($fp, "user.big") === $big);
+fclose($fp);
+
+/* CREATE applies to the value as a whole */
+var_dump(@xattr_set($file, "user.big", $big, XXATTR_XATTR_CREATE));
+
+/* A shorter value drops the chunks it no longer needs */
+var_dump(xattr_set($file, "user.big", substr($big, 0, 250)));
+var_dump(xattr_get($file, "user.big") === substr($big, 0, 250));
+var_dump(@xattr_get($file, "user.big.3"));
+
+var_dump(xattr_set($file, "user.big", "small"));
+var_dump(xattr_get($file, "user.big"));
+var_dump(@xattr_get($file, "user.big.0"));
+
+/* Chunked values still read back once chunking is off, but writes and
+ * lists no longer look for chunks, which stay behind as plain attributes */
+xattr_set($file, "user.big", $big);
+ini_set("xattr.chunk_size", 0);
+var_dump(xattr_get($file, "user.big") === $big);
+var_dump(count(preg_grep('/^user\.big\./', xattr_list($file))));
+var_dump(xattr_set_multi($file, array("user.big" => "plain")));
+var_dump(strlen(xattr_get($file, "user.big.0")));
+ini_set("xattr.chunk_size", 100);
+
+/* Every writer chunks */
+var_dump(xattr_set_multi($file, array("user.big" => $big)));
+var_dump(xattr_get($file, "user.big") === $big);
+var_dump(xattr_cas($file, "user.big", $big, "cas"));
+var_dump(array_values(preg_grep('/^user\./', xattr_list($file))), @xattr_get($file, "user.big.0"));
+var_dump(xattr_bundle_set($file, "user.bundle", array("a" => $big)));
+var_dump(xattr_bundle_get($file, "user.bundle", "a") === $big);
+xattr_remove($file, "user.bundle");
+
+/* A missing chunk makes the value unreadable */
+xattr_set($file, "user.big", $big);
+xattr_remove($file, "user.big.4");
+var_dump(@xattr_get($file, "user.big"));
+
+var_dump(xattr_remove($file, "user.big"));
+var_dump(count(preg_grep('/^user\.big/', xattr_list($file))));
+
+unlink($file);
+?>
+--EXPECT--
+bool(true)
+int(100)
+int(50)
+bool(false)
+bool(true)
+bool(true)
+int(950)
+bool(true)
+bool(true)
+bool(true)
+bool(false)
+bool(true)
+bool(true)
+bool(false)
+bool(true)
+string(5) "small"
+bool(false)
+bool(true)
+int(10)
+array(1) {
+  ["user.big"]=>
+  bool(true)
+}
+int(100)
+array(1) {
+  ["user.big"]=>
+  bool(true)
+}
+bool(true)
+bool(true)
+array(1) {
+  [0]=>
+  string(8) "user.big"
+}
+bool(false)
+bool(true)
+bool(true)
+bool(false)
+bool(true)
+int(0)
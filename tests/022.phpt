@@ -0,0 +1,63 @@
+--TEST--
+Check the counters of xattr.stats, those of the request and xattr_stats_reset()
+--SKIPIF--
+<?php
+if (!extension_loaded("xattr")) print "skip";
+$file = tempnam(sys_get_temp_dir(), "xattr");
+if (!@xattr_set($file, "user.php_test", "1")) print "skip user xattrs not supported";
+unlink($file);
+?>
+--INI--
+xattr.stats=1
+xattr.cache=0
+--FILE--
+<?php
+$file = tempnam(sys_get_temp_dir(), "xattr");
+
+var_dump(xattr_set($file, "user.counted", "12345"));
+var_dump(xattr_get($file, "user.counted"));
+var_dump(xattr_get($file, "user.missing"));
+
+$stats = xattr_stats();
+var_dump($stats["enabled"]);
+var_dump($stats["functions"]["xattr_set"], $stats["functions"]["xattr_get"]);
+var_dump($stats["ops"]["set"]["calls"] >= 1, $stats["ops"]["set"]["bytes"] >= 5);
+var_dump($stats["ops"]["get"]["errors"] >= 1, array_sum($stats["ops"]["get"]["latency_ns"]) == $stats["ops"]["get"]["calls"]);
+var_dump(count($stats["errno"]) > 0);
+var_dump($stats["request"]["functions"] == $stats["functions"], $stats["request"]["ops"]["get"]["calls"] == $stats["ops"]["get"]["calls"]);
+
+var_dump(xattr_stats_reset());
+$stats = xattr_stats();
+var_dump($stats["functions"], $stats["ops"], $stats["errno"]);
+var_dump(xattr_get($file, "user.counted"));
+$stats = xattr_stats();
+var_dump($stats["request"]["functions"]);
+
+unlink($file);
+?>
+--EXPECT--
+bool(true)
+string(5) "12345"
+bool(false)
+bool(true)
+int(1)
+int(2)
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+array(0) {
+}
+array(0) {
+}
+array(0) {
+}
+string(5) "12345"
+array(1) {
+  ["xattr_get"]=>
+  int(1)
+}
@@ -0,0 +1,58 @@
+--TEST--
+Check XATTR_QUIET, xattr.quiet and xattr_last_error()
+--SKIPIF--
+<?php
+if (!extension_loaded("xattr")) print "skip";
+$file = tempnam(sys_get_temp_dir(), "xattr");
+if (!@xattr_set($file, "user.php_test", "1")) print "skip user xattrs not supported";
+unlink($file);
+?>
+--FILE--
+<?php
+$file = tempnam(sys_get_temp_dir(), "xattr");
+$missing = $file . ".missing";
+
+var_dump(xattr_last_error());
+
+var_dump(xattr_get($file, "user.missing", XATTR_QUIET));
+$error = xattr_last_error();
+var_dump($error["errno"] == XATTR_ENOATTR, $error["function"]);
+
+var_dump(xattr_get($missing, "user.test", XATTR_QUIET));
+$error = xattr_last_error();
+var_dump($error["errno"], $error["error"] != "", $error["function"]);
+
+/* Without the flag it warns again */
+var_dump(xattr_get($missing, "user.test"));
+
+ini_set("xattr.quiet", "1");
+var_dump(xattr_remove($missing, "user.test"));
+$error = xattr_last_error();
+var_dump($error["function"]);
+ini_set("xattr.quiet", "0");
+
+/* open_basedir denials are quiet too */
+ini_set("open_basedir", dirname($file));
+var_dump(xattr_get("/", "user.test", XATTR_QUIET));
+$error = xattr_last_error();
+var_dump($error["errno"], $error["function"]);
+
+unlink($file);
+?>
+--EXPECTF--
+NULL
+bool(false)
+bool(true)
+string(9) "xattr_get"
+bool(false)
+int(2)
+bool(true)
+string(9) "xattr_get"
+
+Warning: xattr_get File %s doesn't exists in %s on line %d
+bool(false)
+bool(false)
+string(12) "xattr_remove"
+bool(false)
+int(1)
+string(9) "xattr_get"
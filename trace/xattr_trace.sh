@@ -0,0 +1,32 @@
+#!/bin/sh
+# Run one of the bpftrace scripts next to this one against the xattr
+# extension of a running PHP, without restarting it. Needs root and an
+# extension configured with --enable-xattr-dtrace.
+#   sudo trace/xattr_trace.sh latency
+#   sudo trace/xattr_trace.sh slow 500        # calls over 500 us
+#   sudo XATTR_SO=/path/to/xattr.so trace/xattr_trace.sh errors
+# Every process which has that xattr.so loaded is traced.
+set -e
+
+dir=$(dirname "$0")
+script="$dir/xattr_$1.bt"
+if [ $# -lt 1 ] || [ ! -r "$script" ]; then
+	echo "usage: $0 latency|slow|errors [bpftrace arguments...]" >&2
+	exit 2
+fi
+shift
+
+so=${XATTR_SO:-$(php -r 'echo ini_get("extension_dir");')/xattr.so}
+if [ ! -r "$so" ]; then
+	echo "$so not found, set XATTR_SO" >&2
+	exit 2
+fi
+if ! readelf -n "$so" | grep -q stapsdt; then
+	echo "$so has no probes, configure it with --enable-xattr-dtrace" >&2
+	exit 2
+fi
+
+tmp=$(mktemp /tmp/xattr_trace.XXXXXX)
+trap 'rm -f "$tmp"' EXIT INT TERM
+sed "s|@XATTR_SO@|$so|g" "$script" > "$tmp"
+bpftrace "$tmp" "$@"
@@ -31,31 +31,282 @@
 #include "php.h"
 #include "php_ini.h"
 #include "ext/standard/info.h"
+#include "php_xattr_compat.h"
 #include "php_xattr.h"
 
 #include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
 
 /*
  * One beautiful day libattr will implement listing extended attributes,
  * but until then we must do it on our own, so these headers are required.
  */
 #include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <sys/file.h>
+#include <time.h>
 #include "isdk_xattr.h"
+#include "isdk_xattr_scan.h"
+#include "isdk_xattr_uring.h"
+#include "isdk_xattr_shm.h"
+#include "isdk_xattr_bundle.h"
+#include "isdk_xattr_stats.h"
+
+#ifdef HAVE_XATTR_ZLIB
+#include <zlib.h>
+#endif
+
+#define XATTR_URING_ENTRIES		256
+#define XATTR_URING_MIN_BATCH	8	/* fewer reads aren't worth the round trip */
+
+#define XATTR_ROLLBACK			0x100	/* xattr_set_multi(): all or nothing */
+#define XATTR_QUIET				0x200	/* no warnings, see xattr_last_error() */
+
+#ifdef ENOATTR
+#define XATTR_ENOATTR	ENOATTR
+#else
+#define XATTR_ENOATTR	ENODATA
+#endif
+
+ZEND_DECLARE_MODULE_GLOBALS(xattr)
+
+#define PHP_XATTR_SCAN_RES_NAME	"xattr scan"
+
+static int le_xattr_scan;
+
+/* Mapped at startup, so every process forked afterwards shares it */
+static xattr_shm *xattr_shm_cache;
+
+/* {{{ arginfo */
+ZEND_BEGIN_ARG_INFO_EX(arginfo_xattr_set, 0, 0, 3)
+	ZEND_ARG_INFO(0, path)
+	ZEND_ARG_INFO(0, name)
+	ZEND_ARG_INFO(0, value)
+	ZEND_ARG_INFO(0, flags)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_xattr_get, 0, 0, 2)
+	ZEND_ARG_INFO(0, path)
+	ZEND_ARG_INFO(0, name)
+	ZEND_ARG_INFO(0, flags)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_xattr_remove, 0, 0, 2)
+	ZEND_ARG_INFO(0, path)
+	ZEND_ARG_INFO(0, name)
+	ZEND_ARG_INFO(0, flags)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_xattr_list, 0, 0, 1)
+	ZEND_ARG_INFO(0, path)
+	ZEND_ARG_INFO(0, flags)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_xattr_supported, 0, 0, 1)
+	ZEND_ARG_INFO(0, path)
+	ZEND_ARG_INFO(0, flags)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_xattr_get_multi, 0, 0, 2)
+	ZEND_ARG_INFO(0, path)
+	ZEND_ARG_ARRAY_INFO(0, names, 0)
+	ZEND_ARG_INFO(0, flags)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_xattr_set_multi, 0, 0, 2)
+	ZEND_ARG_INFO(0, path)
+	ZEND_ARG_ARRAY_INFO(0, values, 0)
+	ZEND_ARG_INFO(0, flags)
+	ZEND_ARG_ARRAY_INFO(0, key_flags, 1)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_xattr_bundle_get, 0, 0, 2)
+	ZEND_ARG_INFO(0, path)
+	ZEND_ARG_INFO(0, bundle)
+	ZEND_ARG_INFO(0, field)
+	ZEND_ARG_INFO(0, flags)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_xattr_bundle_set, 0, 0, 3)
+	ZEND_ARG_INFO(0, path)
+	ZEND_ARG_INFO(0, bundle)
+	ZEND_ARG_ARRAY_INFO(0, fields, 0)
+	ZEND_ARG_INFO(0, flags)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_xattr_get_int, 0, 0, 2)
+	ZEND_ARG_INFO(0, path)
+	ZEND_ARG_INFO(0, name)
+	ZEND_ARG_INFO(0, flags)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_xattr_set_int, 0, 0, 3)
+	ZEND_ARG_INFO(0, path)
+	ZEND_ARG_INFO(0, name)
+	ZEND_ARG_INFO(0, value)
+	ZEND_ARG_INFO(0, flags)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_xattr_incr, 0, 0, 2)
+	ZEND_ARG_INFO(0, path)
+	ZEND_ARG_INFO(0, name)
+	ZEND_ARG_INFO(0, by)
+	ZEND_ARG_INFO(0, flags)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_xattr_cas, 0, 0, 4)
+	ZEND_ARG_INFO(0, path)
+	ZEND_ARG_INFO(0, name)
+	ZEND_ARG_INFO(0, expected)
+	ZEND_ARG_INFO(0, value)
+	ZEND_ARG_INFO(0, flags)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_xattr_get_packed, 0, 0, 3)
+	ZEND_ARG_INFO(0, path)
+	ZEND_ARG_INFO(0, name)
+	ZEND_ARG_INFO(0, format)
+	ZEND_ARG_INFO(0, flags)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_xattr_get_all, 0, 0, 1)
+	ZEND_ARG_INFO(0, path)
+	ZEND_ARG_INFO(0, prefix)
+	ZEND_ARG_INFO(0, flags)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_xattr_fset, 0, 0, 3)
+	ZEND_ARG_INFO(0, stream)
+	ZEND_ARG_INFO(0, name)
+	ZEND_ARG_INFO(0, value)
+	ZEND_ARG_INFO(0, flags)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_xattr_fget, 0, 0, 2)
+	ZEND_ARG_INFO(0, stream)
+	ZEND_ARG_INFO(0, name)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_xattr_fremove, 0, 0, 2)
+	ZEND_ARG_INFO(0, stream)
+	ZEND_ARG_INFO(0, name)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_xattr_flist, 0, 0, 1)
+	ZEND_ARG_INFO(0, stream)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_xattr_set_at, 0, 0, 4)
+	ZEND_ARG_INFO(0, dir)
+	ZEND_ARG_INFO(0, file)
+	ZEND_ARG_INFO(0, name)
+	ZEND_ARG_INFO(0, value)
+	ZEND_ARG_INFO(0, flags)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_xattr_get_at, 0, 0, 3)
+	ZEND_ARG_INFO(0, dir)
+	ZEND_ARG_INFO(0, file)
+	ZEND_ARG_INFO(0, name)
+	ZEND_ARG_INFO(0, flags)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_xattr_remove_at, 0, 0, 3)
+	ZEND_ARG_INFO(0, dir)
+	ZEND_ARG_INFO(0, file)
+	ZEND_ARG_INFO(0, name)
+	ZEND_ARG_INFO(0, flags)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_xattr_list_at, 0, 0, 2)
+	ZEND_ARG_INFO(0, dir)
+	ZEND_ARG_INFO(0, file)
+	ZEND_ARG_INFO(0, flags)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_xattr_get_paths, 0, 0, 2)
+	ZEND_ARG_ARRAY_INFO(0, paths, 0)
+	ZEND_ARG_INFO(0, names)
+	ZEND_ARG_INFO(0, flags)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_xattr_scan, 0, 0, 1)
+	ZEND_ARG_INFO(0, root)
+	ZEND_ARG_ARRAY_INFO(0, options, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_xattr_scan_next, 0, 0, 1)
+	ZEND_ARG_INFO(0, scan)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_xattr_scan_close, 0, 0, 1)
+	ZEND_ARG_INFO(0, scan)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_xattr_flush, 0, 0, 0)
+	ZEND_ARG_INFO(0, path)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_xattr_stats, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_xattr_stats_reset, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_xattr_last_error, 0, 0, 0)
+ZEND_END_ARG_INFO()
+/* }}} */
 
 /* {{{ xattr_functions[]
  *
  * Every user visible function must have an entry in xattr_functions[].
  */
 zend_function_entry xattr_functions[] = {
-	PHP_FE(xattr_set,		NULL)
-	PHP_FE(xattr_get,		NULL)
-	PHP_FE(xattr_remove,	NULL)
-	PHP_FE(xattr_list,		NULL)
-	PHP_FE(xattr_supported,	NULL)
+	PHP_FE(xattr_set,		arginfo_xattr_set)
+	PHP_FE(xattr_get,		arginfo_xattr_get)
+	PHP_FE(xattr_remove,	arginfo_xattr_remove)
+	PHP_FE(xattr_list,		arginfo_xattr_list)
+	PHP_FE(xattr_supported,	arginfo_xattr_supported)
+	PHP_FE(xattr_get_multi,	arginfo_xattr_get_multi)
+	PHP_FE(xattr_get_all,	arginfo_xattr_get_all)
+	PHP_FE(xattr_set_multi,	arginfo_xattr_set_multi)
+	PHP_FE(xattr_bundle_get,	arginfo_xattr_bundle_get)
+	PHP_FE(xattr_bundle_set,	arginfo_xattr_bundle_set)
+	PHP_FE(xattr_get_int,	arginfo_xattr_get_int)
+	PHP_FE(xattr_set_int,	arginfo_xattr_set_int)
+	PHP_FE(xattr_get_float,	arginfo_xattr_get_int)
+	PHP_FE(xattr_set_float,	arginfo_xattr_set_int)
+	PHP_FE(xattr_incr,		arginfo_xattr_incr)
+	PHP_FE(xattr_cas,		arginfo_xattr_cas)
+	PHP_FE(xattr_get_packed,	arginfo_xattr_get_packed)
+	PHP_FE(xattr_fset,		arginfo_xattr_fset)
+	PHP_FE(xattr_fget,		arginfo_xattr_fget)
+	PHP_FE(xattr_fremove,	arginfo_xattr_fremove)
+	PHP_FE(xattr_flist,		arginfo_xattr_flist)
+	PHP_FE(xattr_set_at,	arginfo_xattr_set_at)
+	PHP_FE(xattr_get_at,	arginfo_xattr_get_at)
+	PHP_FE(xattr_remove_at,	arginfo_xattr_remove_at)
+	PHP_FE(xattr_list_at,	arginfo_xattr_list_at)
+	PHP_FE(xattr_get_paths,	arginfo_xattr_get_paths)
+	PHP_FE(xattr_scan,		arginfo_xattr_scan)
+	PHP_FE(xattr_scan_next,	arginfo_xattr_scan_next)
+	PHP_FE(xattr_scan_close,	arginfo_xattr_scan_close)
+	PHP_FE(xattr_flush,		arginfo_xattr_flush)
+	PHP_FE(xattr_stats,		arginfo_xattr_stats)
+	PHP_FE(xattr_stats_reset,	arginfo_xattr_stats_reset)
+	PHP_FE(xattr_last_error,	arginfo_xattr_last_error)
 	{NULL, NULL, NULL}	/* Must be the last line in xattr_functions[] */
 };
 /* }}} */
 
+static PHP_GINIT_FUNCTION(xattr);
+static PHP_GSHUTDOWN_FUNCTION(xattr);
+
 /* {{{ xattr_module_entry
  */
 zend_module_entry xattr_module_entry = {
@@ -65,323 +316,3918 @@ zend_module_entry xattr_module_entry = {
 	"xattr",
 	xattr_functions,
 	PHP_MINIT(xattr),
+	PHP_MSHUTDOWN(xattr),
 	NULL,
-	NULL,
-	NULL,
+	PHP_RSHUTDOWN(xattr),
 	PHP_MINFO(xattr),
 #if ZEND_MODULE_API_NO >= 20010901
 	PHP_XATTR_VERSION,
 #endif
-	STANDARD_MODULE_PROPERTIES
+	PHP_MODULE_GLOBALS(xattr),
+	PHP_GINIT(xattr),
+	PHP_GSHUTDOWN(xattr),
+	NULL,
+	STANDARD_MODULE_PROPERTIES_EX
 };
 /* }}} */
 
 #ifdef COMPILE_DL_XATTR
+#if defined(ZTS) && PHP_MAJOR_VERSION >= 7
+ZEND_TSRMLS_CACHE_DEFINE()
+#endif
 ZEND_GET_MODULE(xattr)
 #endif
 
+/* {{{ PHP_INI
+ */
+PHP_INI_BEGIN()
+	STD_PHP_INI_BOOLEAN("xattr.io_uring", "0", PHP_INI_ALL, OnUpdateBool, io_uring, zend_xattr_globals, xattr_globals)
+	STD_PHP_INI_BOOLEAN("xattr.cache", "0", PHP_INI_ALL, OnUpdateBool, cache, zend_xattr_globals, xattr_globals)
+	STD_PHP_INI_ENTRY("xattr.cache_size", "1M", PHP_INI_ALL, OnUpdateLong, cache_size, zend_xattr_globals, xattr_globals)
+	STD_PHP_INI_BOOLEAN("xattr.write_behind", "0", PHP_INI_ALL, OnUpdateBool, write_behind, zend_xattr_globals, xattr_globals)
+	STD_PHP_INI_BOOLEAN("xattr.compress", "0", PHP_INI_ALL, OnUpdateBool, compress, zend_xattr_globals, xattr_globals)
+	STD_PHP_INI_ENTRY("xattr.compress_threshold", "1024", PHP_INI_ALL, OnUpdateLong, compress_threshold, zend_xattr_globals, xattr_globals)
+	STD_PHP_INI_ENTRY("xattr.chunk_size", "0", PHP_INI_ALL, OnUpdateLong, chunk_size, zend_xattr_globals, xattr_globals)
+	STD_PHP_INI_BOOLEAN("xattr.stats", "0", PHP_INI_ALL, OnUpdateBool, stats, zend_xattr_globals, xattr_globals)
+	STD_PHP_INI_BOOLEAN("xattr.quiet", "0", PHP_INI_ALL, OnUpdateBool, quiet, zend_xattr_globals, xattr_globals)
+	STD_PHP_INI_ENTRY("xattr.shm_size", "0", PHP_INI_SYSTEM, OnUpdateLong, shm_size, zend_xattr_globals, xattr_globals)
+PHP_INI_END()
+/* }}} */
+
+/* {{{ PHP_GINIT_FUNCTION
+ */
+static PHP_GINIT_FUNCTION(xattr)
+{
+#if defined(COMPILE_DL_XATTR) && defined(ZTS) && PHP_MAJOR_VERSION >= 7
+	ZEND_TSRMLS_CACHE_UPDATE();
+#endif
+	memset(xattr_globals, 0, sizeof(*xattr_globals));
+}
+/* }}} */
+
+/* {{{ PHP_GSHUTDOWN_FUNCTION
+ */
+static PHP_GSHUTDOWN_FUNCTION(xattr)
+{
+	xattr_uring_close((xattr_uring *) xattr_globals->uring);
+	if (xattr_globals->stats_base) {
+		pefree(xattr_globals->stats_base, 1);
+	}
+}
+/* }}} */
+
+/* {{{ php_xattr_scan_dtor
+ */
+XATTR_RSRC_DTOR_FUNC(php_xattr_scan_dtor)
+{
+	xattr_scan_close((xattr_scan *) rsrc->ptr);
+}
+/* }}} */
+
 /* {{{ PHP_MINIT_FUNCTION
  */
 PHP_MINIT_FUNCTION(xattr)
 {
+	le_xattr_scan = zend_register_list_destructors_ex(php_xattr_scan_dtor, NULL, PHP_XATTR_SCAN_RES_NAME, module_number);
+
 	REGISTER_LONG_CONSTANT("XATTR_ROOT", ATTR_ROOT, CONST_CS | CONST_PERSISTENT);
 	REGISTER_LONG_CONSTANT("XXATTR_XATTR_NOFOLLOW", XATTR_XATTR_NOFOLLOW, CONST_CS | CONST_PERSISTENT);
 	REGISTER_LONG_CONSTANT("XXATTR_XATTR_CREATE", XATTR_XATTR_CREATE, CONST_CS | CONST_PERSISTENT);
 	REGISTER_LONG_CONSTANT("XXATTR_XATTR_REPLACE", XATTR_XATTR_REPLACE, CONST_CS | CONST_PERSISTENT);
+	REGISTER_LONG_CONSTANT("XATTR_ROLLBACK", XATTR_ROLLBACK, CONST_CS | CONST_PERSISTENT);
+	REGISTER_LONG_CONSTANT("XATTR_QUIET", XATTR_QUIET, CONST_CS | CONST_PERSISTENT);
+	REGISTER_LONG_CONSTANT("XATTR_ENOATTR", XATTR_ENOATTR, CONST_CS | CONST_PERSISTENT);
+
+	REGISTER_INI_ENTRIES();
+
+	if (XATTR_G(shm_size) > 0) {
+		xattr_shm_cache = xattr_shm_open((size_t) XATTR_G(shm_size));
+		if (!xattr_shm_cache) {
+			php_error(E_WARNING, "xattr.shm_size: unable to set up a shared cache of %ld bytes: %s", (long) XATTR_G(shm_size), strerror(errno));
+		}
+	}
 
 	return SUCCESS;
 }
 /* }}} */
 
-/* {{{ PHP_MINFO_FUNCTION
+/* {{{ PHP_MSHUTDOWN_FUNCTION
  */
-PHP_MINFO_FUNCTION(xattr)
+PHP_MSHUTDOWN_FUNCTION(xattr)
 {
-	php_info_print_table_start();
-	php_info_print_table_row(2, "xattr support", "enabled");
-	php_info_print_table_row(2, "PECL module version", PHP_XATTR_VERSION);
-	php_info_print_table_end();
+	UNREGISTER_INI_ENTRIES();
+
+	xattr_shm_close(xattr_shm_cache);
+	xattr_shm_cache = NULL;
+
+	return SUCCESS;
 }
 /* }}} */
 
-/* {{{ proto bool xattr_set(string path, string name, string value [, int flags])
-   Set an extended attribute of file */
-PHP_FUNCTION(xattr_set)
+static void php_xattr_cache_clear(TSRMLS_D);
+static void php_xattr_basedir_clear(TSRMLS_D);
+static int php_xattr_queue_sync(const char *path TSRMLS_DC);
+static void php_xattr_queue_clear(TSRMLS_D);
+static int php_xattr_error(int err TSRMLS_DC);
+
+/* {{{ PHP_RSHUTDOWN_FUNCTION
+ */
+PHP_RSHUTDOWN_FUNCTION(xattr)
 {
-	char *attr_name = NULL;
-	char *attr_value = NULL;
-	char *path = NULL;
-	int error, tmp, value_len, flags = 0;
+	/* open_basedir and the caches are still needed while writing */
+	XATTR_G(quiet_call) = XATTR_G(quiet);
+	php_xattr_queue_sync(NULL TSRMLS_CC);
+	php_xattr_queue_clear(TSRMLS_C);
+	php_xattr_cache_clear(TSRMLS_C);
+	php_xattr_basedir_clear(TSRMLS_C);
+	XATTR_G(last_errno) = 0;
+	XATTR_G(last_function) = NULL;
+	XATTR_G(stats_base_taken) = 0;
 
-	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "sss|l", &path, &tmp, &attr_name, &tmp, &attr_value, &value_len, &flags) == FAILURE) {
-		return;
+	return SUCCESS;
+}
+/* }}} */
+
+/*
+ * Every function starts with XATTR_FUNCTION_ENTER(). It's quiet if
+ * xattr.quiet is on, or once XATTR_QUIET_FLAG() finds XATTR_QUIET among
+ * its flags, see php_xattr_error().
+ *
+ * With xattr.stats on the backend counts its calls, see isdk_xattr_stats.h,
+ * and every function here counts how often it is called. The counters are
+ * those of this process, or of this thread in ZTS builds, since it started
+ * or since xattr_stats_reset(). The first counted call of a request takes
+ * a copy of them, what the request did is the difference. With it off,
+ * all a function pays is testing two flags.
+ */
+#define XATTR_FUNCTION_ENTER() \
+	XATTR_G(quiet_call) = XATTR_G(quiet); \
+	if (XATTR_G(stats) || xattr_stats_on) { \
+		php_xattr_stats_call(TSRMLS_C); \
 	}
 
-	/* Enforce open_basedir and safe_mode */
-	if (php_check_open_basedir(path TSRMLS_CC) 
-#if PHP_API_VERSION < 20100412
-	|| (PG(safe_mode) && !php_checkuid(path, NULL, CHECKUID_DISALLOW_FILE_NOT_EXISTS))
-#endif
-	) {
-		RETURN_FALSE;
+#define XATTR_QUIET_FLAG(flags) \
+	if ((flags) & XATTR_QUIET) { \
+		XATTR_G(quiet_call) = 1; \
 	}
-	
-	/* Ensure that only allowed bits are set */
-	flags &= ATTR_ROOT | XATTR_XATTR_NOFOLLOW | XATTR_XATTR_CREATE | XATTR_XATTR_REPLACE; 
-	
-	/* Attempt to set an attribute, warn if failed. */ 
-	error = xattr_setxattr(path, attr_name, attr_value, value_len, 0, flags);
-	if (error == -1) {
-		switch (errno) {
-			case E2BIG:
-				php_error(E_WARNING, "%s The value of the given attribute is too large", get_active_function_name(TSRMLS_C));
-				break;
-			case EPERM:
-			case EACCES:
-				php_error(E_WARNING, "%s Permission denied", get_active_function_name(TSRMLS_C));
-				break;
-			case EOPNOTSUPP:
-				php_error(E_WARNING, "%s Operation not supported", get_active_function_name(TSRMLS_C));
-				break;
-			case ENOENT:
-			case ENOTDIR:
-				php_error(E_WARNING, "%s File %s doesn't exists", get_active_function_name(TSRMLS_C), path);
-				break;
-		}
-		
-		RETURN_FALSE;
+
+/* {{{ php_xattr_stats_request
+ * Copy the counters, those of the request start from here
+ */
+static void php_xattr_stats_request(TSRMLS_D)
+{
+	int i;
+
+	if (!XATTR_G(stats_base)) {
+		XATTR_G(stats_base) = pemalloc(sizeof(xattr_stats), 1);
 	}
-	
-	RETURN_TRUE;
+	memcpy(XATTR_G(stats_base), xattr_stats_get(), sizeof(xattr_stats));
+	for (i = 0; i < XATTR_STATS_FUNCTIONS; i++) {
+		XATTR_G(stats_calls_base)[i] = i < XATTR_G(stats_functions) ? XATTR_G(stats_calls)[i].calls : 0;
+	}
+	XATTR_G(stats_base_taken) = 1;
 }
 /* }}} */
 
-/* {{{ proto string xattr_get(string path, string name [, int flags])
-   Returns a value of an extended attribute */
-PHP_FUNCTION(xattr_get)
+/* {{{ php_xattr_stats_call
+ */
+static void php_xattr_stats_call(TSRMLS_D)
 {
-	char *attr_name = NULL;
-	char *attr_value = NULL;
-	char *path = NULL;
-	int error, tmp, flags = 0;
-	ssize_t buffer_size = XATTR_BUFFER_SIZE;
+	const char *name;
+	int i;
 
-	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "ss|l", &path, &tmp, &attr_name, &tmp, &flags) == FAILURE) {
+	/* xattr.stats may have been changed by ini_set() */
+	xattr_stats_enable(XATTR_G(stats));
+	if (!XATTR_G(stats)) {
 		return;
 	}
+	if (!XATTR_G(stats_base_taken)) {
+		php_xattr_stats_request(TSRMLS_C);
+	}
 
-	/* Enforce open_basedir and safe_mode */
-	if (php_check_open_basedir(path TSRMLS_CC) 
-#if PHP_API_VERSION < 20100412
-	|| (PG(safe_mode) && !php_checkuid(path, NULL, CHECKUID_DISALLOW_FILE_NOT_EXISTS))
-#endif
-	) {
-		RETURN_FALSE;
+	name = get_active_function_name(TSRMLS_C);
+	for (i = 0; i < XATTR_G(stats_functions); i++) {
+		if (XATTR_G(stats_calls)[i].name == name || !strcmp(XATTR_G(stats_calls)[i].name, name)) {
+			XATTR_G(stats_calls)[i].calls++;
+			return;
+		}
 	}
-	
-	/* Ensure that only allowed bits are set */
-	flags &= ATTR_ROOT | XATTR_XATTR_NOFOLLOW; 
-	
-	
-	/* 
-	 * If buffer is NULL then attr_get return the buffer_size
-	 */
-	buffer_size = xattr_getxattr(path, attr_name, NULL, 0, 0, flags);
-	if (buffer_size >= 0) {
-		/* Allocate a buffer with starting size XATTR_BUFFER_SIZE bytes */
-		attr_value = emalloc(buffer_size);
-		if (!attr_value)
-			RETURN_FALSE;
-		error = xattr_getxattr(path, attr_name, attr_value, buffer_size, 0, flags);
-		/* Return a string if everything is ok */
-		if (error>=0) {
-			RETURN_STRINGL(attr_value, buffer_size, 0);
-		} 
-		
-		/* Error handling part */
-		efree(attr_value);
+	if (i < XATTR_STATS_FUNCTIONS) {
+		XATTR_G(stats_calls)[i].name = name;
+		XATTR_G(stats_calls)[i].calls = 1;
+		XATTR_G(stats_functions)++;
 	}
+}
+/* }}} */
 
-	
-	/* Give warning for some common error conditions */
-	switch (errno) {
-		case ENOENT:
-		case ENOTDIR:
-			php_error(E_WARNING, "%s File %s doesn't exists", get_active_function_name(TSRMLS_C), path);
-			break;
-		case EPERM:
-		case EACCES:
-			php_error(E_WARNING, "%s Permission denied", get_active_function_name(TSRMLS_C));
-			break;
-		case EOPNOTSUPP:
-			php_error(E_WARNING, "%s Operation not supported", get_active_function_name(TSRMLS_C));
-			break;
+/* {{{ php_xattr_stats_info
+ */
+static void php_xattr_stats_info(TSRMLS_D)
+{
+	const xattr_stats *stats = xattr_stats_get();
+	const xattr_op_stats *op;
+	char calls[32], errors[32], bytes[32], avg[32];
+	int i;
+
+	php_info_print_table_start();
+	php_info_print_table_header(2, "Instrumentation", XATTR_G(stats) ? "enabled" : "disabled");
+	php_info_print_table_end();
+
+	php_info_print_table_start();
+	php_info_print_table_header(5, "Backend call", "Calls", "Errors", "Bytes", "Average ns");
+	for (i = 0; i < XATTR_OP_COUNT; i++) {
+		op = &stats->ops[i];
+		if (!op->calls) {
+			continue;
+		}
+		snprintf(calls, sizeof(calls), "%llu", (unsigned long long) op->calls);
+		snprintf(errors, sizeof(errors), "%llu", (unsigned long long) op->errors);
+		snprintf(bytes, sizeof(bytes), "%llu", (unsigned long long) op->bytes);
+		snprintf(avg, sizeof(avg), "%llu", (unsigned long long) (op->nsec / op->calls));
+		php_info_print_table_row(5, xattr_stats_op_name((xattr_stats_op) i), calls, errors, bytes, avg);
 	}
-	
-	RETURN_FALSE;
+	php_info_print_table_end();
+
+	php_info_print_table_start();
+	php_info_print_table_header(2, "Function", "Calls");
+	for (i = 0; i < XATTR_G(stats_functions); i++) {
+		snprintf(calls, sizeof(calls), "%lu", XATTR_G(stats_calls)[i].calls);
+		php_info_print_table_row(2, XATTR_G(stats_calls)[i].name, calls);
+	}
+	php_info_print_table_end();
 }
 /* }}} */
 
-/* {{{ proto bool xattr_supported(string path [, int flags])
-   Checks if filesystem supports extended attributes */
-PHP_FUNCTION(xattr_supported)
+/* {{{ PHP_MINFO_FUNCTION
+ */
+PHP_MINFO_FUNCTION(xattr)
 {
-	char *buffer, *path = NULL;
-	int error, tmp, flags = 0;
+	char buf[32];
 
-	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "s|l", &path, &tmp, &flags) == FAILURE) {
-		return;
-	}
-	
-	/* Enforce open_basedir and safe_mode */
-	if (php_check_open_basedir(path TSRMLS_CC) 
-#if PHP_API_VERSION < 20100412
-	|| (PG(safe_mode) && !php_checkuid(path, NULL, CHECKUID_DISALLOW_FILE_NOT_EXISTS))
+	php_info_print_table_start();
+	php_info_print_table_row(2, "xattr support", "enabled");
+	php_info_print_table_row(2, "PECL module version", PHP_XATTR_VERSION);
+#ifdef HAVE_XATTR_ZLIB
+	php_info_print_table_row(2, "Compression", "zlib");
+#else
+	php_info_print_table_row(2, "Compression", "unavailable");
 #endif
-	) {
-		RETURN_NULL();
-	}
-	
-	/* Is "test" a good name? */
-	error = xattr_getxattr(path, "user.test", NULL, 0 ,0, flags);
+	php_info_print_table_end();
 
-	if (error >= 0)
-		RETURN_TRUE;
-	
-	switch (errno) {
-		case ENOTSUP:
-			RETURN_FALSE;
-		case ENOENT:
-		case ENOTDIR:
-			php_error(E_WARNING, "%s File %s doesn't exists", get_active_function_name(TSRMLS_C), path);
-			break;
-		case EACCES:
-			php_error(E_WARNING, "%s Permission denied", get_active_function_name(TSRMLS_C));
-			break;
-	}
-	
-	RETURN_NULL();
+	php_info_print_table_start();
+	php_info_print_table_header(2, "Request cache", "This process");
+	snprintf(buf, sizeof(buf), "%lu", XATTR_G(cache_hits));
+	php_info_print_table_row(2, "Hits", buf);
+	snprintf(buf, sizeof(buf), "%lu", XATTR_G(cache_misses));
+	php_info_print_table_row(2, "Misses", buf);
+	php_info_print_table_end();
+
+	php_info_print_table_start();
+	php_info_print_table_header(2, "Shared cache", xattr_shm_cache ? "enabled" : "disabled");
+	snprintf(buf, sizeof(buf), "%lu", (unsigned long) xattr_shm_slots(xattr_shm_cache));
+	php_info_print_table_row(2, "Slots", buf);
+	snprintf(buf, sizeof(buf), "%lu", XATTR_G(shm_hits));
+	php_info_print_table_row(2, "Hits in this process", buf);
+	snprintf(buf, sizeof(buf), "%lu", XATTR_G(shm_misses));
+	php_info_print_table_row(2, "Misses in this process", buf);
+	php_info_print_table_end();
+
+	php_xattr_stats_info(TSRMLS_C);
+
+	DISPLAY_INI_ENTRIES();
 }
 /* }}} */
 
-/* {{{ proto string xattr_remove(string path, string name [, int flags])
-   Remove an extended attribute of file */
-PHP_FUNCTION(xattr_remove)
+/*
+ * Directories open_basedir was found to allow during this request. Any
+ * file right inside of them is allowed as well, as long as it isn't a
+ * symlink which may point anywhere. A directory found not to be allowed
+ * says nothing about what's in it (open_basedir=/a/b allows /a/b and
+ * /a/bc but not /a), so denials are remembered by the full path instead,
+ * up to XATTR_BASEDIR_DENIED_MAX of them. A path which is denied stays so
+ * even if a symlink on the way changes, which errs on the safe side. Both
+ * tables are emptied whenever open_basedir is no longer the string they
+ * were built for.
+ */
+#define XATTR_BASEDIR_DENIED_MAX	1024
+
+static void php_xattr_basedir_clear(TSRMLS_D)
 {
-	char *attr_name = NULL;
-	char *path = NULL;
-	int error, tmp, flags = 0;
-	
-	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "ss|l", &path, &tmp, &attr_name, &tmp, &flags) == FAILURE) {
-		return;
+	if (XATTR_G(basedir_table)) {
+		zend_hash_destroy(XATTR_G(basedir_table));
+		FREE_HASHTABLE(XATTR_G(basedir_table));
+		XATTR_G(basedir_table) = NULL;
 	}
-	
-	/* Enforce open_basedir and safe_mode */
-	if (php_check_open_basedir(path TSRMLS_CC) 
-#if PHP_API_VERSION < 20100412
-	|| (PG(safe_mode) && !php_checkuid(path, NULL, CHECKUID_DISALLOW_FILE_NOT_EXISTS))
-#endif
-	) {
-		RETURN_FALSE;
+	if (XATTR_G(basedir_denied)) {
+		zend_hash_destroy(XATTR_G(basedir_denied));
+		FREE_HASHTABLE(XATTR_G(basedir_denied));
+		XATTR_G(basedir_denied) = NULL;
 	}
-	
-	/* Ensure that only allowed bits are set */
-	flags &= ATTR_ROOT | XATTR_XATTR_NOFOLLOW; 
-	
-	/* Attempt to remove an attribute, warn if failed. */ 
-	error = xattr_removexattr(path, attr_name, flags);
-	if (error == -1) {
-		switch (errno) {
-			case E2BIG:
-				php_error(E_WARNING, "%s The value of the given attribute is too large", get_active_function_name(TSRMLS_C));
-				break;
-			case EPERM:
-			case EACCES:
-				php_error(E_WARNING, "%s Permission denied", get_active_function_name(TSRMLS_C));
-				break;
-			case EOPNOTSUPP:
-				php_error(E_WARNING, "%s Operation not supported", get_active_function_name(TSRMLS_C));
-				break;
-			case ENOENT:
-			case ENOTDIR:
-				php_error(E_WARNING, "%s File %s doesn't exists", get_active_function_name(TSRMLS_C), path);
-				break;
-		}
-		
-		RETURN_FALSE;
+	if (XATTR_G(basedir_for)) {
+		efree(XATTR_G(basedir_for));
+		XATTR_G(basedir_for) = NULL;
 	}
-	
-	RETURN_TRUE;
 }
-/* }}} */
 
-/* {{{ proto array xattr_list(string path [, int flags])
-   Get list of extended attributes of file */
-PHP_FUNCTION(xattr_list)
+/* {{{ php_xattr_basedir_cached
+ * Whether the tables may be used at all, emptying them if open_basedir changed
+ */
+static int php_xattr_basedir_cached(TSRMLS_D)
 {
-	char *buffer, *path = NULL;
-	char *p, *prefix;
-	int error, tmp, flags = 0;
-	ssize_t i = 0, buffer_size = XATTR_BUFFER_SIZE;
-	size_t len, prefix_len;
-	
-	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "s|l", &path, &tmp, &flags) == FAILURE) {
-		return;
-	}
-	
-	/* Enforce open_basedir and safe_mode */
-	if (php_check_open_basedir(path TSRMLS_CC) 
+	if (!PG(open_basedir) || !*PG(open_basedir)
 #if PHP_API_VERSION < 20100412
-	|| (PG(safe_mode) && !php_checkuid(path, NULL, CHECKUID_DISALLOW_FILE_NOT_EXISTS))
+		|| PG(safe_mode)
 #endif
-	) {
-		RETURN_FALSE;
+		) {
+		return 0;
 	}
 
-	buffer_size = xattr_listxattr(path, NULL, 0, flags);
-	if (buffer_size >= 0) {
-		buffer = emalloc(buffer_size);
-		if (!buffer)
-			RETURN_FALSE;
-		error = xattr_listxattr(path, buffer, buffer_size, flags);
-		if (error >=0) {
-			array_init(return_value);
-			p = buffer;
-			
-			
-			/* 
-			 * We go through the whole list and add entries beginning with selected
-			 * prefix to the return_value array.
-			 */
-			while (i != buffer_size) {
-				len = strlen(p) + 1;	/* +1 for NULL */
-				add_next_index_stringl(return_value, p, len, 1);
-				
-				p += len;
-				i += len;
+	if (XATTR_G(basedir_for) && strcmp(XATTR_G(basedir_for), PG(open_basedir)) != 0) {
+		php_xattr_basedir_clear(TSRMLS_C);
+	}
+	if (!XATTR_G(basedir_for)) {
+		XATTR_G(basedir_for) = estrdup(PG(open_basedir));
+	}
+	return 1;
+}
+/* }}} */
+
+/* {{{ php_xattr_basedir_allowed
+ * Returns 1 when path is known to be allowed without the full check, -1
+ * when it is known not to be, 0 when only the full check can tell
+ */
+static int php_xattr_basedir_allowed(const char *path TSRMLS_DC)
+{
+	char dir[MAXPATHLEN];
+	const char *base;
+	size_t dir_len;
+	struct stat sb;
+
+	if (!php_xattr_basedir_cached(TSRMLS_C)) {
+		return 0;
+	}
+
+	if (XATTR_G(basedir_denied) && xattr_hash_find_ptr(XATTR_G(basedir_denied), path, strlen(path))) {
+		XATTR_G(basedir_hits)++;
+		return -1;
+	}
+
+	/* Relative paths depend on the working directory, which may change */
+	base = strrchr(path, '/');
+	if (path[0] != '/' || !base[1] || strcmp(base + 1, ".") == 0 || strcmp(base + 1, "..") == 0) {
+		return 0;
+	}
+	dir_len = base == path ? 1 : (size_t) (base - path);
+	if (dir_len >= sizeof(dir)) {
+		return 0;
+	}
+	memcpy(dir, path, dir_len);
+	dir[dir_len] = '\0';
+
+	if (!XATTR_G(basedir_table) || !xattr_hash_find_ptr(XATTR_G(basedir_table), dir, dir_len)) {
+		XATTR_G(basedir_misses)++;
+		if (php_check_open_basedir_ex(dir, 0 TSRMLS_CC)) {
+			return 0;
+		}
+		if (!XATTR_G(basedir_table)) {
+			ALLOC_HASHTABLE(XATTR_G(basedir_table));
+			zend_hash_init(XATTR_G(basedir_table), 16, NULL, NULL, 0);
+		}
+		/* Only the key matters */
+		xattr_hash_update_ptr(XATTR_G(basedir_table), dir, dir_len, XATTR_G(basedir_table));
+	} else {
+		XATTR_G(basedir_hits)++;
+	}
+
+	/*
+	 * The file itself has to be looked at on every call: the directory
+	 * being allowed covers it only if it isn't a symlink, and what path
+	 * names may change between calls. A single lstat() is still much
+	 * cheaper than the realpath() of every component the full check does.
+	 */
+	return lstat(path, &sb) == -1 ? errno == ENOENT : !S_ISLNK(sb.st_mode);
+}
+/* }}} */
+
+/* {{{ php_xattr_basedir_deny
+ * Remember that the full check didn't allow path
+ */
+static void php_xattr_basedir_deny(const char *path TSRMLS_DC)
+{
+	/* Relative paths depend on the working directory, which may change */
+	if (path[0] != '/' || !php_xattr_basedir_cached(TSRMLS_C)) {
+		return;
+	}
+	if (!XATTR_G(basedir_denied)) {
+		ALLOC_HASHTABLE(XATTR_G(basedir_denied));
+		zend_hash_init(XATTR_G(basedir_denied), 16, NULL, NULL, 0);
+	}
+	if (zend_hash_num_elements(XATTR_G(basedir_denied)) < XATTR_BASEDIR_DENIED_MAX) {
+		/* Only the key matters */
+		xattr_hash_update_ptr(XATTR_G(basedir_denied), path, strlen(path), XATTR_G(basedir_denied));
+	}
+}
+/* }}} */
+
+/* {{{ php_xattr_check_basedir
+ * Enforce open_basedir and safe_mode, returns non-zero if the path is not allowed.
+ * A quiet call only gets EPERM as its last error, without the warning.
+ */
+static int php_xattr_check_basedir(const char *path TSRMLS_DC)
+{
+	int quiet = XATTR_G(quiet_call), known;
+
+	known = php_xattr_basedir_allowed(path TSRMLS_CC);
+	if (known == 1) {
+		return 0;
+	}
+	if (known == -1) {
+		/* Only the warning is wanted from the full check */
+		if (!quiet) {
+			php_check_open_basedir_ex(path, 1 TSRMLS_CC);
+		}
+		php_xattr_error(EPERM TSRMLS_CC);
+		return 1;
+	}
+	if (php_check_open_basedir_ex(path, !quiet TSRMLS_CC)) {
+		php_xattr_basedir_deny(path TSRMLS_CC);
+		php_xattr_error(EPERM TSRMLS_CC);
+		return 1;
+	}
+#if PHP_API_VERSION < 20100412
+	if (PG(safe_mode) && !php_checkuid_ex(path, NULL, CHECKUID_DISALLOW_FILE_NOT_EXISTS, quiet ? CHECKUID_NO_ERRORS : 0)) {
+		php_xattr_error(EPERM TSRMLS_CC);
+		return 1;
+	}
+#endif
+	return 0;
+}
+/* }}} */
+
+/* {{{ php_xattr_check_basedir_quiet
+ * The same without any warning, for functions dealing with many paths at once
+ */
+static int php_xattr_check_basedir_quiet(const char *path TSRMLS_DC)
+{
+	int known = php_xattr_basedir_allowed(path TSRMLS_CC);
+
+	if (known) {
+		return known == -1;
+	}
+	if (php_check_open_basedir_ex(path, 0 TSRMLS_CC)) {
+		php_xattr_basedir_deny(path TSRMLS_CC);
+		return 1;
+	}
+#if PHP_API_VERSION < 20100412
+	if (PG(safe_mode) && !php_checkuid_ex(path, NULL, CHECKUID_DISALLOW_FILE_NOT_EXISTS, CHECKUID_NO_ERRORS)) {
+		return 1;
+	}
+#endif
+	return 0;
+}
+/* }}} */
+
+/* {{{ php_xattr_error
+ * Keep err as the last error, for xattr_last_error(), and tell whether to
+ * warn about it, which a quiet call doesn't: nothing is formatted then.
+ */
+static int php_xattr_error(int err TSRMLS_DC)
+{
+	XATTR_G(last_errno) = err;
+	XATTR_G(last_function) = get_active_function_name(TSRMLS_C);
+	return !XATTR_G(quiet_call);
+}
+/* }}} */
+
+/* {{{ php_xattr_warn
+ * Give warning for some common error conditions, path is NULL for streams
+ */
+static void php_xattr_warn(int err, const char *path TSRMLS_DC)
+{
+	if (!php_xattr_error(err TSRMLS_CC)) {
+		return;
+	}
+
+	switch (err) {
+		case E2BIG:
+			php_error(E_WARNING, "%s The value of the given attribute is too large", get_active_function_name(TSRMLS_C));
+			break;
+		case EPERM:
+		case EACCES:
+			php_error(E_WARNING, "%s Permission denied", get_active_function_name(TSRMLS_C));
+			break;
+		case EOPNOTSUPP:
+#if defined(ENOTSUP) && ENOTSUP != EOPNOTSUPP
+		case ENOTSUP:
+#endif
+			php_error(E_WARNING, "%s Operation not supported", get_active_function_name(TSRMLS_C));
+			break;
+		case ENOENT:
+		case ENOTDIR:
+			if (path) {
+				php_error(E_WARNING, "%s File %s doesn't exists", get_active_function_name(TSRMLS_C), path);
+			}
+			break;
+	}
+}
+/* }}} */
+
+/*
+ * Per request cache of values read by xattr_get() and lists read by
+ * xattr_list(), when xattr.cache is on, and the cache shared by all
+ * processes when xattr.shm_size is set. Entries belong to an inode and are
+ * trusted only while its ctime stays what it was when they were read:
+ * setting or removing any attribute updates it, whoever does so.
+ */
+#ifdef __APPLE__
+#define XATTR_CTIME_NSEC(sb)	((sb)->st_ctimespec.tv_nsec)
+#else
+#define XATTR_CTIME_NSEC(sb)	((sb)->st_ctim.tv_nsec)
+#endif
+
+#define XATTR_CACHE_VALUE	'v'
+#define XATTR_CACHE_LIST	'l'
+#define XATTR_CACHE_NAME_MAX	255
+#define XATTR_CACHE_RACY	2	/* seconds, see php_xattr_cache_store() */
+
+typedef struct _php_xattr_cache_key {
+	dev_t dev;
+	ino_t ino;
+	int flags;
+	char kind;
+} php_xattr_cache_key;
+
+typedef struct _php_xattr_cache_entry {
+	time_t ctime;
+	long ctime_nsec;
+	ssize_t len;		/* -1 for an attribute known to be missing */
+	size_t size;		/* counted against xattr.cache_size */
+	char data[1];
+} php_xattr_cache_entry;
+
+XATTR_HASH_PTR_DTOR(php_xattr_cache_dtor, efree)
+
+/* {{{ php_xattr_cache_clear
+ */
+static void php_xattr_cache_clear(TSRMLS_D)
+{
+	if (XATTR_G(cache_table)) {
+		zend_hash_destroy(XATTR_G(cache_table));
+		FREE_HASHTABLE(XATTR_G(cache_table));
+		XATTR_G(cache_table) = NULL;
+	}
+	XATTR_G(cache_bytes) = 0;
+}
+/* }}} */
+
+/* {{{ php_xattr_cache_stat
+ * Look at the inode the call is about to touch, returns -1 if it can't be cached
+ */
+static int php_xattr_cache_stat(const char *path, int flags, struct stat *sb TSRMLS_DC)
+{
+	if (!XATTR_G(cache) && !xattr_shm_cache) {
+		return -1;
+	}
+	return (flags & XATTR_XATTR_NOFOLLOW) ? lstat(path, sb) : stat(path, sb);
+}
+/* }}} */
+
+/* {{{ php_xattr_cache_make_key
+ * Build the key into buf, which has room for a name of XATTR_CACHE_NAME_MAX
+ * bytes. Returns its length, or 0 if the name is too long to be cached.
+ */
+static size_t php_xattr_cache_make_key(char *buf, char kind, const struct stat *sb, int flags, const char *name, size_t name_len)
+{
+	php_xattr_cache_key key;
+
+	if (name_len > XATTR_CACHE_NAME_MAX) {
+		return 0;
+	}
+
+	/* Zero the padding too, the key is hashed as it is */
+	memset(&key, 0, sizeof(key));
+	key.dev = sb->st_dev;
+	key.ino = sb->st_ino;
+	key.flags = flags & ATTR_ROOT;
+	key.kind = kind;
+
+	memcpy(buf, &key, sizeof(key));
+	memcpy(buf + sizeof(key), name, name_len);
+	buf[sizeof(key) + name_len] = '\0';
+	return sizeof(key) + name_len;
+}
+/* }}} */
+
+/* {{{ php_xattr_shm_make_key
+ */
+static void php_xattr_shm_make_key(xattr_shm_key *key, char kind, const struct stat *sb, int flags, const char *name, size_t name_len)
+{
+	key->dev = (uint64_t) sb->st_dev;
+	key->ino = (uint64_t) sb->st_ino;
+	key->flags = flags & ATTR_ROOT;
+	key->kind = kind;
+	key->name = name;
+	key->name_len = name_len;
+}
+/* }}} */
+
+/* {{{ php_xattr_cache_drop
+ */
+static void php_xattr_cache_drop(const char *key, size_t key_len TSRMLS_DC)
+{
+	php_xattr_cache_entry *entry;
+
+	entry = (php_xattr_cache_entry *) xattr_hash_find_ptr(XATTR_G(cache_table), key, key_len);
+	if (entry) {
+		XATTR_G(cache_bytes) -= entry->size;
+		xattr_hash_del(XATTR_G(cache_table), key, key_len);
+	}
+}
+/* }}} */
+
+/* {{{ php_xattr_cache_find
+ * Look for what's known about name, in this request first and then in the
+ * shared cache. scratch has room for XATTR_SHM_DATA_MAX bytes, data may
+ * point into it. Returns 1 and sets data and len on a hit, len is -1 for
+ * an attribute known to be missing.
+ */
+static int php_xattr_cache_find(char kind, const struct stat *sb, int flags, const char *name, size_t name_len, char *scratch, const char **data, ssize_t *len TSRMLS_DC)
+{
+	char buf[sizeof(php_xattr_cache_key) + XATTR_CACHE_NAME_MAX + 1];
+	php_xattr_cache_entry *entry = NULL;
+	xattr_shm_key shm_key;
+	size_t key_len;
+
+	if (XATTR_G(cache)) {
+		key_len = php_xattr_cache_make_key(buf, kind, sb, flags, name, name_len);
+		if (key_len && XATTR_G(cache_table)) {
+			entry = (php_xattr_cache_entry *) xattr_hash_find_ptr(XATTR_G(cache_table), buf, key_len);
+		}
+		if (entry && (entry->ctime != sb->st_ctime || entry->ctime_nsec != XATTR_CTIME_NSEC(sb))) {
+			XATTR_G(cache_bytes) -= entry->size;
+			xattr_hash_del(XATTR_G(cache_table), buf, key_len);
+			entry = NULL;
+		}
+
+		if (entry) {
+			XATTR_G(cache_hits)++;
+			*data = entry->data;
+			*len = entry->len;
+			return 1;
+		}
+		XATTR_G(cache_misses)++;
+	}
+
+	if (xattr_shm_cache) {
+		php_xattr_shm_make_key(&shm_key, kind, sb, flags, name, name_len);
+		*len = xattr_shm_get(xattr_shm_cache, &shm_key, (int64_t) sb->st_ctime, XATTR_CTIME_NSEC(sb), scratch, XATTR_SHM_DATA_MAX);
+		if (*len != XATTR_SHM_MISS) {
+			XATTR_G(shm_hits)++;
+			*data = scratch;
+			return 1;
+		}
+		XATTR_G(shm_misses)++;
+	}
+
+	return 0;
+}
+/* }}} */
+
+/* {{{ php_xattr_cache_store
+ * Remember what was read from the inode sb describes, len is -1 for a
+ * missing attribute. path is looked at again first: if it's a different
+ * inode now or its ctime moved, what was read may belong to either state.
+ */
+static void php_xattr_cache_store(char kind, const char *path, const struct stat *sb, int flags, const char *name, size_t name_len, const char *data, ssize_t len TSRMLS_DC)
+{
+	char buf[sizeof(php_xattr_cache_key) + XATTR_CACHE_NAME_MAX + 1];
+	php_xattr_cache_entry *entry;
+	xattr_shm_key shm_key;
+	struct stat now;
+	size_t key_len, size;
+
+	if (php_xattr_cache_stat(path, flags, &now TSRMLS_CC) == -1
+		|| now.st_dev != sb->st_dev || now.st_ino != sb->st_ino
+		|| now.st_ctime != sb->st_ctime || XATTR_CTIME_NSEC(&now) != XATTR_CTIME_NSEC(sb)) {
+		return;
+	}
+
+	/*
+	 * Timestamps are coarser than the changes they record, so another
+	 * change within the same tick would go unnoticed. Files changed
+	 * just now are not cached for that reason.
+	 */
+	if (time(NULL) - sb->st_ctime < XATTR_CACHE_RACY) {
+		return;
+	}
+
+	if (xattr_shm_cache) {
+		php_xattr_shm_make_key(&shm_key, kind, sb, flags, name, name_len);
+		xattr_shm_put(xattr_shm_cache, &shm_key, (int64_t) sb->st_ctime, XATTR_CTIME_NSEC(sb), data, len);
+	}
+
+	if (!XATTR_G(cache)) {
+		return;
+	}
+	key_len = php_xattr_cache_make_key(buf, kind, sb, flags, name, name_len);
+	size = sizeof(*entry) + key_len + (len > 0 ? len : 0);
+	if (!key_len || size > (size_t) XATTR_G(cache_size) / 4) {
+		return;
+	}
+
+	if (!XATTR_G(cache_table)) {
+		ALLOC_HASHTABLE(XATTR_G(cache_table));
+		zend_hash_init(XATTR_G(cache_table), 64, NULL, php_xattr_cache_dtor, 0);
+	}
+	/* Simply start over once full */
+	php_xattr_cache_drop(buf, key_len TSRMLS_CC);
+	if (XATTR_G(cache_bytes) + size > (size_t) XATTR_G(cache_size)) {
+		zend_hash_clean(XATTR_G(cache_table));
+		XATTR_G(cache_bytes) = 0;
+	}
+
+	entry = emalloc(sizeof(*entry) + (len > 0 ? len : 0));
+	entry->ctime = sb->st_ctime;
+	entry->ctime_nsec = XATTR_CTIME_NSEC(sb);
+	entry->len = len;
+	entry->size = size;
+	if (len > 0) {
+		memcpy(entry->data, data, len);
+	}
+	XATTR_G(cache_bytes) += size;
+	xattr_hash_update_ptr(XATTR_G(cache_table), buf, key_len, entry);
+}
+/* }}} */
+
+/* {{{ php_xattr_cache_forget_inode
+ * Drop what's known about name and the list of names of the inode sb
+ */
+static void php_xattr_cache_forget_inode(const struct stat *sb, int flags, const char *name TSRMLS_DC)
+{
+	char buf[sizeof(php_xattr_cache_key) + XATTR_CACHE_NAME_MAX + 1];
+	xattr_shm_key shm_key;
+	size_t key_len;
+
+	/* Other processes notice the new ctime anyway, this only frees the slots */
+	if (xattr_shm_cache) {
+		php_xattr_shm_make_key(&shm_key, XATTR_CACHE_VALUE, sb, flags, name, strlen(name));
+		xattr_shm_forget(xattr_shm_cache, &shm_key);
+		php_xattr_shm_make_key(&shm_key, XATTR_CACHE_LIST, sb, flags, "", 0);
+		xattr_shm_forget(xattr_shm_cache, &shm_key);
+	}
+	if (!XATTR_G(cache_table)) {
+		return;
+	}
+
+	key_len = php_xattr_cache_make_key(buf, XATTR_CACHE_VALUE, sb, flags, name, strlen(name));
+	if (key_len) {
+		php_xattr_cache_drop(buf, key_len TSRMLS_CC);
+	}
+	key_len = php_xattr_cache_make_key(buf, XATTR_CACHE_LIST, sb, flags, "", 0);
+	php_xattr_cache_drop(buf, key_len TSRMLS_CC);
+}
+/* }}} */
+
+/* {{{ php_xattr_cache_forget
+ * Drop what's known about name and the list of names of path after a write
+ */
+static void php_xattr_cache_forget(const char *path, int fd, int flags, const char *name TSRMLS_DC)
+{
+	struct stat sb;
+
+	if (!XATTR_G(cache_table) && !xattr_shm_cache) {
+		return;
+	}
+	if (fd != -1 ? fstat(fd, &sb) == -1 : php_xattr_cache_stat(path, flags, &sb TSRMLS_CC) == -1) {
+		return;
+	}
+	php_xattr_cache_forget_inode(&sb, flags, name TSRMLS_CC);
+}
+/* }}} */
+
+/* {{{ php_xattr_cache_forget_at
+ * The same for file inside the open directory dirfd. The *_at functions
+ * don't read through the cache, but xattr_get() may have the same inode.
+ */
+static void php_xattr_cache_forget_at(int dirfd, const char *file, int flags, const char *name TSRMLS_DC)
+{
+	struct stat sb;
+
+	if (!XATTR_G(cache_table) && !xattr_shm_cache) {
+		return;
+	}
+	if (fstatat(dirfd, file, &sb, (flags & XATTR_XATTR_NOFOLLOW) ? AT_SYMLINK_NOFOLLOW : 0) == -1) {
+		return;
+	}
+	php_xattr_cache_forget_inode(&sb, flags, name TSRMLS_CC);
+}
+/* }}} */
+
+/*
+ * A file whose attributes are accessed several times in a row. It is opened
+ * once, so every following call goes through the descriptor instead of
+ * resolving the path again. When the file can't be opened (no read
+ * permission, a symlink which must not be followed) the path based
+ * functions are used instead.
+ */
+typedef struct _php_xattr_target {
+	const char *path;	/* relative to dirfd unless that's -1 */
+	int dirfd;
+	int fd;
+	int flags;
+} php_xattr_target;
+
+/* {{{ php_xattr_target_open
+ * Returns -1 and leaves errno set only if the file doesn't exist
+ */
+static int php_xattr_target_open(php_xattr_target *target, const char *path, int flags)
+{
+	int open_flags = O_RDONLY | O_NONBLOCK | O_NOCTTY;
+
+	target->path = path;
+	target->flags = flags;
+	target->dirfd = -1;
+	target->fd = -1;
+
+	if (flags & XATTR_XATTR_NOFOLLOW) {
+#ifdef O_NOFOLLOW
+		open_flags |= O_NOFOLLOW;
+#else
+		return 0;
+#endif
+	}
+
+	target->fd = open(path, open_flags);
+	if (target->fd == -1 && (errno == ENOENT || errno == ENOTDIR)) {
+		return -1;
+	}
+	return 0;
+}
+/* }}} */
+
+/* {{{ php_xattr_target_path
+ * Access the file by path only, for a single call that's cheaper than opening it
+ */
+static void php_xattr_target_path(php_xattr_target *target, const char *path, int flags)
+{
+	target->path = path;
+	target->flags = flags;
+	target->dirfd = -1;
+	target->fd = -1;
+}
+/* }}} */
+
+/* {{{ php_xattr_target_fd
+ * Access an open file, the caller stays the owner of fd
+ */
+static void php_xattr_target_fd(php_xattr_target *target, int fd)
+{
+	target->path = NULL;
+	target->flags = 0;
+	target->dirfd = -1;
+	target->fd = fd;
+}
+/* }}} */
+
+/* {{{ php_xattr_target_at
+ * Access the file name inside an open directory, the caller stays the owner of dirfd
+ */
+static void php_xattr_target_at(php_xattr_target *target, int dirfd, const char *name, int flags)
+{
+	target->path = name;
+	target->flags = flags;
+	target->dirfd = dirfd;
+	target->fd = -1;
+}
+/* }}} */
+
+/* {{{ php_xattr_stream_fd
+ * Get the descriptor of an open stream, the stream stays its owner
+ */
+static int php_xattr_stream_fd(zval *zstream, int *fd TSRMLS_DC)
+{
+	php_stream *stream;
+
+	xattr_stream_from_zval(stream, zstream);
+	if (!stream) {
+		return FAILURE;
+	}
+
+#if !defined(PHP_WIN32) && defined(PHP_STREAM_FLAG_IS_DIR)
+	/* opendir() streams of plain directories can't be cast, but they wrap a DIR */
+	if ((stream->flags & PHP_STREAM_FLAG_IS_DIR) && stream->wrapper == &php_plain_files_wrapper) {
+		*fd = dirfd((DIR *) stream->abstract);
+		if (*fd == -1) {
+			php_xattr_error(errno TSRMLS_CC);
+			return FAILURE;
+		}
+		return SUCCESS;
+	}
+#endif
+
+	/* Streams which have no descriptor, e.g. php://memory, warn unless quiet */
+	if (php_stream_cast(stream, PHP_STREAM_AS_FD, (void **) fd, XATTR_G(quiet_call) ? 0 : REPORT_ERRORS) == FAILURE) {
+		php_xattr_error(EBADF TSRMLS_CC);
+		return FAILURE;
+	}
+	return SUCCESS;
+}
+/* }}} */
+
+/* {{{ php_xattr_check_component
+ * Only a single component below a directory may be accessed, so nothing
+ * can get past open_basedir that way
+ */
+static int php_xattr_check_component(int dirfd, const char *name, int flags TSRMLS_DC)
+{
+	struct stat sb;
+
+	if (!*name || strchr(name, '/') || !strcmp(name, "..")) {
+		if (php_xattr_error(EINVAL TSRMLS_CC)) {
+			php_error(E_WARNING, "%s %s is not a single path component", get_active_function_name(TSRMLS_C), name);
+		}
+		return FAILURE;
+	}
+
+	/* A symlink may point anywhere, so don't follow it if open_basedir is set */
+	if (!(flags & XATTR_XATTR_NOFOLLOW) && PG(open_basedir) && *PG(open_basedir)
+		&& fstatat(dirfd, name, &sb, AT_SYMLINK_NOFOLLOW) == 0 && S_ISLNK(sb.st_mode)) {
+		if (php_xattr_error(EPERM TSRMLS_CC)) {
+			php_error(E_WARNING, "%s open_basedir restriction in effect, %s is a symlink", get_active_function_name(TSRMLS_C), name);
+		}
+		return FAILURE;
+	}
+
+	return SUCCESS;
+}
+/* }}} */
+
+static void php_xattr_target_close(php_xattr_target *target)
+{
+	if (target->fd != -1) {
+		close(target->fd);
+		target->fd = -1;
+	}
+}
+
+static ssize_t php_xattr_target_getxattr(php_xattr_target *target, const char *name, void *value, size_t size)
+{
+	if (target->fd != -1) {
+		return xattr_fgetxattr(target->fd, name, value, size, 0, 0);
+	}
+	if (target->dirfd != -1) {
+		return xattr_getxattrat(target->dirfd, target->path, name, value, size, target->flags);
+	}
+	return xattr_getxattr(target->path, name, value, size, 0, target->flags);
+}
+
+static ssize_t php_xattr_target_listxattr(php_xattr_target *target, char *namebuf, size_t size)
+{
+	if (target->fd != -1) {
+		return xattr_flistxattr(target->fd, namebuf, size, 0);
+	}
+	if (target->dirfd != -1) {
+		return xattr_listxattrat(target->dirfd, target->path, namebuf, size, target->flags);
+	}
+	return xattr_listxattr(target->path, namebuf, size, target->flags);
+}
+
+static ssize_t php_xattr_target_call(php_xattr_target *target, const char *name, char *buffer, size_t size)
+{
+	if (name) {
+		return php_xattr_target_getxattr(target, name, buffer, size);
+	}
+	return php_xattr_target_listxattr(target, buffer, size);
+}
+
+/* {{{ php_xattr_target_retry_size
+ * Decide whether the len bytes read into a size bytes buffer are the whole
+ * value, or the whole list of names if name is NULL. Returns 0 if so, -1 on
+ * error or the buffer size to try again with.
+ *
+ * The size is asked for only here, so small values cost a single call. A
+ * buffer filled up exactly counts as too small as well, since that's all
+ * FreeBSD and Solaris report on truncation. The value may keep changing
+ * between the calls, so callers have to loop.
+ */
+static ssize_t php_xattr_target_retry_size(php_xattr_target *target, const char *name, ssize_t len, ssize_t size)
+{
+	if (len >= 0 && len < size) {
+		return 0;
+	}
+	if (len < 0 && errno != ERANGE) {
+		return -1;
+	}
+	size = php_xattr_target_call(target, name, NULL, 0);
+	if (size < 0) {
+		return -1;
+	}
+	return size == len ? 0 : size + 1;
+}
+/* }}} */
+
+/* {{{ php_xattr_target_setxattr
+ */
+static int php_xattr_target_setxattr(php_xattr_target *target, const char *name, const char *value, size_t size, int options)
+{
+	if (target->fd != -1) {
+		return (int) xattr_fsetxattr(target->fd, name, (void *) value, size, 0, options);
+	}
+	if (target->dirfd != -1) {
+		return (int) xattr_setxattrat(target->dirfd, target->path, name, (void *) value, size, target->flags | options);
+	}
+	return (int) xattr_setxattr(target->path, name, (void *) value, size, 0, target->flags | options);
+}
+/* }}} */
+
+/* {{{ php_xattr_target_removexattr
+ */
+static int php_xattr_target_removexattr(php_xattr_target *target, const char *name)
+{
+	if (target->fd != -1) {
+		return (int) xattr_fremovexattr(target->fd, name, 0);
+	}
+	if (target->dirfd != -1) {
+		return (int) xattr_removexattrat(target->dirfd, target->path, name, target->flags);
+	}
+	return (int) xattr_removexattr(target->path, name, target->flags);
+}
+/* }}} */
+
+static int php_xattr_target_store(php_xattr_target *target, const char *name, const char *value, size_t len, int options TSRMLS_DC);
+
+/*
+ * Writes held back by xattr.write_behind until xattr_flush() or the end of
+ * the request. Pending values are grouped by file, so each file is opened
+ * once when flushed, and a name written again only keeps its last value.
+ * Files are told apart by the path string and the NOFOLLOW and ROOT flags:
+ * a call through another spelling of the same path, a descriptor or a
+ * directory handle doesn't know which entry is about its file, so those
+ * flush the whole queue before doing anything.
+ */
+typedef struct _php_xattr_pending_file {
+	HashTable names;	/* name => php_xattr_pending_value */
+	int flags;
+	char path[1];
+} php_xattr_pending_file;
+
+typedef struct _php_xattr_pending_value {
+	size_t name_len;
+	size_t len;
+	char data[1];		/* the name, its NUL and then the value */
+} php_xattr_pending_value;
+
+static void php_xattr_pending_file_free(php_xattr_pending_file *file)
+{
+	zend_hash_destroy(&file->names);
+	efree(file);
+}
+
+XATTR_HASH_PTR_DTOR(php_xattr_pending_file_dtor, php_xattr_pending_file_free)
+XATTR_HASH_PTR_DTOR(php_xattr_pending_value_dtor, efree)
+
+/* {{{ php_xattr_queue_key
+ * The flags and then the path, returns its length or 0 if it doesn't fit
+ */
+static size_t php_xattr_queue_key(char *buf, const char *path, int flags)
+{
+	size_t path_len = strlen(path);
+
+	if (path_len + 2 > MAXPATHLEN) {
+		return 0;
+	}
+	buf[0] = (char) ('a' + (flags & (XATTR_XATTR_NOFOLLOW | ATTR_ROOT)));
+	memcpy(buf + 1, path, path_len + 1);
+	return path_len + 1;
+}
+/* }}} */
+
+/* {{{ php_xattr_queue_add
+ * Returns FAILURE when the write has to be done right away instead
+ */
+static int php_xattr_queue_add(const char *path, int flags, const char *name, size_t name_len, const char *value, size_t value_len TSRMLS_DC)
+{
+	char key[MAXPATHLEN];
+	php_xattr_pending_file *file;
+	php_xattr_pending_value *pending;
+	size_t key_len;
+
+	key_len = php_xattr_queue_key(key, path, flags);
+	if (!key_len) {
+		return FAILURE;
+	}
+
+	if (!XATTR_G(queue)) {
+		ALLOC_HASHTABLE(XATTR_G(queue));
+		zend_hash_init(XATTR_G(queue), 8, NULL, php_xattr_pending_file_dtor, 0);
+	}
+
+	file = (php_xattr_pending_file *) xattr_hash_find_ptr(XATTR_G(queue), key, key_len);
+	if (!file) {
+		file = emalloc(sizeof(*file) + key_len - 1);
+		zend_hash_init(&file->names, 8, NULL, php_xattr_pending_value_dtor, 0);
+		file->flags = flags & (XATTR_XATTR_NOFOLLOW | ATTR_ROOT);
+		memcpy(file->path, key + 1, key_len);
+		xattr_hash_update_ptr(XATTR_G(queue), key, key_len, file);
+	}
+
+	if (xattr_hash_find_ptr(&file->names, name, name_len)) {
+		XATTR_G(queue_coalesced)++;
+	}
+	pending = emalloc(sizeof(*pending) + name_len + value_len);
+	pending->name_len = name_len;
+	pending->len = value_len;
+	memcpy(pending->data, name, name_len);
+	pending->data[name_len] = '\0';
+	memcpy(pending->data + name_len + 1, value, value_len);
+	xattr_hash_update_ptr(&file->names, name, name_len, pending);
+	XATTR_G(queue_writes)++;
+
+	return SUCCESS;
+}
+/* }}} */
+
+/* {{{ php_xattr_queue_write
+ * Write out everything pending for one file, returns FAILURE if anything failed
+ */
+static int php_xattr_queue_write(php_xattr_pending_file *file TSRMLS_DC)
+{
+	php_xattr_target target;
+	php_xattr_pending_value *pending;
+	HashPosition pos;
+	int result = SUCCESS;
+	void *data;
+
+	if (php_xattr_target_open(&target, file->path, file->flags) == -1) {
+		php_xattr_warn(errno, file->path TSRMLS_CC);
+		return FAILURE;
+	}
+
+	for (zend_hash_internal_pointer_reset_ex(&file->names, &pos);
+		(data = xattr_hash_get_current_ptr(&file->names, &pos)) != NULL;
+		zend_hash_move_forward_ex(&file->names, &pos)) {
+		pending = (php_xattr_pending_value *) data;
+		if (php_xattr_target_store(&target, pending->data, pending->data + pending->name_len + 1, pending->len, file->flags & ATTR_ROOT TSRMLS_CC) == -1) {
+			php_xattr_warn(errno, file->path TSRMLS_CC);
+			result = FAILURE;
+			continue;
+		}
+		php_xattr_cache_forget(file->path, target.fd, file->flags, pending->data TSRMLS_CC);
+	}
+
+	php_xattr_target_close(&target);
+	return result;
+}
+/* }}} */
+
+/* {{{ php_xattr_queue_sync
+ * Write what's pending for path, or for every file when path is NULL
+ */
+static int php_xattr_queue_sync(const char *path TSRMLS_DC)
+{
+	static const int variants[] = { 0, XATTR_XATTR_NOFOLLOW, ATTR_ROOT, XATTR_XATTR_NOFOLLOW | ATTR_ROOT };
+	char key[MAXPATHLEN];
+	php_xattr_pending_file *file;
+	HashPosition pos;
+	size_t key_len, i;
+	int result = SUCCESS;
+	void *data;
+
+	if (!XATTR_G(queue) || !zend_hash_num_elements(XATTR_G(queue))) {
+		return SUCCESS;
+	}
+
+	if (!path) {
+		for (zend_hash_internal_pointer_reset_ex(XATTR_G(queue), &pos);
+			(data = xattr_hash_get_current_ptr(XATTR_G(queue), &pos)) != NULL;
+			zend_hash_move_forward_ex(XATTR_G(queue), &pos)) {
+			if (php_xattr_queue_write((php_xattr_pending_file *) data TSRMLS_CC) == FAILURE) {
+				result = FAILURE;
+			}
+		}
+		zend_hash_clean(XATTR_G(queue));
+		return result;
+	}
+
+	for (i = 0; i < sizeof(variants) / sizeof(variants[0]); i++) {
+		key_len = php_xattr_queue_key(key, path, variants[i]);
+		if (key_len && (file = (php_xattr_pending_file *) xattr_hash_find_ptr(XATTR_G(queue), key, key_len)) != NULL) {
+			if (php_xattr_queue_write(file TSRMLS_CC) == FAILURE) {
+				result = FAILURE;
+			}
+			xattr_hash_del(XATTR_G(queue), key, key_len);
+		}
+	}
+	return result;
+}
+/* }}} */
+
+/* {{{ php_xattr_queue_clear
+ */
+static void php_xattr_queue_clear(TSRMLS_D)
+{
+	if (XATTR_G(queue)) {
+		zend_hash_destroy(XATTR_G(queue));
+		FREE_HASHTABLE(XATTR_G(queue));
+		XATTR_G(queue) = NULL;
+	}
+}
+/* }}} */
+
+/* {{{ php_xattr_target_read
+ * Read a value straight into a string which is then handed over to userland
+ * as it is, see xattr_zval_string(). Returns its length or -1.
+ */
+static ssize_t php_xattr_target_read(php_xattr_target *target, const char *name, xattr_string **value)
+{
+	ssize_t size = XATTR_BUFFER_SIZE, len, retry;
+
+	*value = xattr_string_alloc(size);
+	for (;;) {
+		len = php_xattr_target_getxattr(target, name, xattr_string_val(*value), size);
+		retry = php_xattr_target_retry_size(target, name, len, size);
+		if (retry <= 0) {
+			break;
+		}
+		size = retry;
+		*value = xattr_string_realloc(*value, size);
+	}
+
+	if (retry < 0) {
+		xattr_string_free(*value);
+		return -1;
+	}
+
+	/* Don't hand a mostly empty buffer over to userland */
+	if (size - len > XATTR_BUFFER_SIZE / 4) {
+		*value = xattr_string_realloc(*value, len);
+	}
+	return len;
+}
+/* }}} */
+
+/* Fixed width little endian numbers, as stored by compressed and chunked values and xattr_set_int() */
+static uint64_t php_xattr_le_get(const unsigned char *p, size_t n)
+{
+	uint64_t v = 0;
+
+	while (n-- > 0) {
+		v = (v << 8) | p[n];
+	}
+	return v;
+}
+
+static void php_xattr_le_put(unsigned char *p, uint64_t v, size_t n)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++, v >>= 8) {
+		p[i] = (unsigned char) (v & 0xff);
+	}
+}
+
+/*
+ * With xattr.compress on, values longer than xattr.compress_threshold are
+ * stored deflated behind a header no text can start with: a NUL, "XZ", a
+ * version byte and the original length (4 bytes, little endian). Values
+ * carrying it are inflated again when read, whatever xattr.compress is
+ * now, anything else is returned as it is.
+ */
+#define XATTR_COMPRESS_MAGIC	"\0XZ\1"
+#define XATTR_COMPRESS_HEADER	8
+#define XATTR_COMPRESS_MAX		(16 * 1024 * 1024)	/* refuse to inflate anything larger */
+
+/* {{{ php_xattr_deflate
+ * Returns what to store in place of value, or NULL to store value as it is
+ */
+static char *php_xattr_deflate(const char *value, size_t len, size_t *out_len TSRMLS_DC)
+{
+#ifdef HAVE_XATTR_ZLIB
+	uLongf size;
+	char *out;
+
+	if (!XATTR_G(compress) || XATTR_G(compress_threshold) < 0
+		|| len <= (size_t) XATTR_G(compress_threshold) || len > XATTR_COMPRESS_MAX) {
+		return NULL;
+	}
+
+	size = compressBound((uLong) len);
+	out = emalloc(XATTR_COMPRESS_HEADER + size);
+	if (compress2((Bytef *) out + XATTR_COMPRESS_HEADER, &size, (const Bytef *) value, (uLong) len, Z_DEFAULT_COMPRESSION) != Z_OK
+		|| XATTR_COMPRESS_HEADER + size >= len) {
+		/* Not worth it */
+		efree(out);
+		return NULL;
+	}
+
+	memcpy(out, XATTR_COMPRESS_MAGIC, 4);
+	out[4] = (char) (len & 0xff);
+	out[5] = (char) ((len >> 8) & 0xff);
+	out[6] = (char) ((len >> 16) & 0xff);
+	out[7] = (char) ((len >> 24) & 0xff);
+	*out_len = XATTR_COMPRESS_HEADER + size;
+	return out;
+#else
+	return NULL;
+#endif
+}
+/* }}} */
+
+/* {{{ php_xattr_inflate
+ * Returns the original of a value stored by php_xattr_deflate(), NULL for anything else
+ */
+static xattr_string *php_xattr_inflate(const char *data, size_t len, size_t *out_len TSRMLS_DC)
+{
+#ifdef HAVE_XATTR_ZLIB
+	const unsigned char *u = (const unsigned char *) data;
+	xattr_string *out;
+	uLongf size;
+	size_t orig;
+
+	if (len < XATTR_COMPRESS_HEADER || memcmp(data, XATTR_COMPRESS_MAGIC, 4) != 0) {
+		return NULL;
+	}
+	orig = (size_t) u[4] | (size_t) u[5] << 8 | (size_t) u[6] << 16 | (size_t) u[7] << 24;
+	if (orig > XATTR_COMPRESS_MAX) {
+		return NULL;
+	}
+
+	out = xattr_string_alloc(orig);
+	size = (uLongf) orig;
+	if (uncompress((Bytef *) xattr_string_val(out), &size, u + XATTR_COMPRESS_HEADER, (uLong) (len - XATTR_COMPRESS_HEADER)) != Z_OK
+		|| size != orig) {
+		xattr_string_free(out);
+		return NULL;
+	}
+	*out_len = orig;
+	return out;
+#else
+	return NULL;
+#endif
+}
+/* }}} */
+
+/* {{{ php_xattr_uring
+ * The io_uring instance of this process or thread if xattr.io_uring is on,
+ * NULL when it's off or the kernel can't do xattr ops through io_uring.
+ */
+static xattr_uring *php_xattr_uring(TSRMLS_D)
+{
+	if (!XATTR_G(io_uring) || XATTR_G(uring_failed)) {
+		return NULL;
+	}
+	if (!XATTR_G(uring)) {
+		XATTR_G(uring) = xattr_uring_open(XATTR_URING_ENTRIES);
+		if (!XATTR_G(uring)) {
+			XATTR_G(uring_failed) = 1;
+		}
+	}
+	return (xattr_uring *) XATTR_G(uring);
+}
+/* }}} */
+
+/* {{{ php_xattr_batch_prepare
+ * Set op up to read name of target into a fresh buffer of the usual size
+ */
+static void php_xattr_batch_prepare(xattr_batch_op *op, php_xattr_target *target, const char *name, xattr_string **value)
+{
+	*value = xattr_string_alloc(XATTR_BUFFER_SIZE);
+	op->opcode = XATTR_BATCH_GET;
+	op->fd = target->fd;
+	op->path = target->path;
+	op->name = name;
+	op->value = xattr_string_val(*value);
+	op->size = XATTR_BUFFER_SIZE;
+	op->options = target->fd != -1 ? 0 : target->flags;
+}
+/* }}} */
+
+/* {{{ php_xattr_batch_result
+ * What php_xattr_target_read() would have returned for a batched op. Values
+ * which didn't fit the first buffer are read again through target.
+ */
+static ssize_t php_xattr_batch_result(xattr_batch_op *op, php_xattr_target *target, xattr_string **value)
+{
+	ssize_t len = op->result;
+
+	if (len >= 0 && len < XATTR_BUFFER_SIZE) {
+		if (XATTR_BUFFER_SIZE - len > XATTR_BUFFER_SIZE / 4) {
+			*value = xattr_string_realloc(*value, len);
+		}
+		return len;
+	}
+	xattr_string_free(*value);
+	if (len < 0 && op->err != ERANGE) {
+		errno = op->err;
+		return -1;
+	}
+	return php_xattr_target_read(target, op->name, value);
+}
+/* }}} */
+
+/* {{{ php_xattr_target_read_batch
+ * php_xattr_target_read() for count names. lens[i] is -1 for values which
+ * couldn't be read, values[i] must not be used then. Batches big enough go
+ * through io_uring in one go.
+ */
+static void php_xattr_target_read_batch(php_xattr_target *target, const char **names, size_t count, xattr_string **values, ssize_t *lens TSRMLS_DC)
+{
+	xattr_uring *ring = NULL;
+	xattr_batch_op *ops;
+	size_t i;
+
+	/* io_uring knows nothing about directory relative paths */
+	if (count >= XATTR_URING_MIN_BATCH && target->dirfd == -1) {
+		ring = php_xattr_uring(TSRMLS_C);
+	}
+	if (!ring) {
+		for (i = 0; i < count; i++) {
+			lens[i] = php_xattr_target_read(target, names[i], &values[i]);
+		}
+		return;
+	}
+
+	ops = safe_emalloc(count, sizeof(*ops), 0);
+	for (i = 0; i < count; i++) {
+		php_xattr_batch_prepare(&ops[i], target, names[i], &values[i]);
+	}
+
+	xattr_batch_run(ring, ops, count);
+
+	for (i = 0; i < count; i++) {
+		lens[i] = php_xattr_batch_result(&ops[i], target, &values[i]);
+	}
+	efree(ops);
+}
+/* }}} */
+
+/*
+ * With xattr.chunk_size set, values longer than that are stored in pieces
+ * of chunk_size bytes, name.0 to name.N, and name itself holds a manifest
+ * behind a header like that of compressed values: a NUL, "XC", a version
+ * byte, then the length of the value, the chunk size and the number of
+ * chunks (4 bytes each, little endian). Compression comes first, so the
+ * chunks hold the deflated value. Manifests are followed when read,
+ * whatever xattr.chunk_size is now, the chunks are read straight into the
+ * final buffer, through io_uring when there are enough of them.
+ *
+ * Only with chunking on do writes and removals look for a manifest first,
+ * so no chunks of an earlier value are left behind, and lists leave the
+ * chunks out; that costs a read of at most XATTR_CHUNK_MANIFEST bytes.
+ * With it off nothing is paid: a value written over a chunked one leaves
+ * its chunks behind as ordinary attributes.
+ */
+#define XATTR_CHUNK_MAGIC		"\0XC\1"
+#define XATTR_CHUNK_MANIFEST	16
+#define XATTR_CHUNK_MAX			(64 * 1024 * 1024)	/* refuse to assemble anything larger */
+#define XATTR_CHUNK_SUFFIX		12					/* ".4294967295" and its NUL */
+
+#define XATTR_CHUNKING()		(XATTR_G(chunk_size) > 0)
+
+/* {{{ php_xattr_chunk_manifest
+ * Parse a manifest, returns FAILURE for anything else
+ */
+static int php_xattr_chunk_manifest(const char *data, size_t len, size_t *total, size_t *chunk_size, size_t *count)
+{
+	const unsigned char *u = (const unsigned char *) data;
+
+	if (len != XATTR_CHUNK_MANIFEST || memcmp(data, XATTR_CHUNK_MAGIC, 4) != 0) {
+		return FAILURE;
+	}
+	*total = (size_t) php_xattr_le_get(u + 4, 4);
+	*chunk_size = (size_t) php_xattr_le_get(u + 8, 4);
+	*count = (size_t) php_xattr_le_get(u + 12, 4);
+	if (!*chunk_size || *total > XATTR_CHUNK_MAX || *count != (*total + *chunk_size - 1) / *chunk_size) {
+		return FAILURE;
+	}
+	return SUCCESS;
+}
+/* }}} */
+
+/* {{{ php_xattr_chunk_count
+ * The number of chunks the current value of name has, 0 if it isn't chunked
+ * or doesn't exist. *exists tells whether it exists.
+ */
+static size_t php_xattr_chunk_count(php_xattr_target *target, const char *name, int *exists)
+{
+	char manifest[XATTR_CHUNK_MANIFEST];
+	size_t total, chunk_size, count;
+	ssize_t len;
+
+	len = php_xattr_target_getxattr(target, name, manifest, sizeof(manifest));
+	*exists = len >= 0 || errno == ERANGE;
+	if (len < 0 || php_xattr_chunk_manifest(manifest, (size_t) len, &total, &chunk_size, &count) == FAILURE) {
+		return 0;
+	}
+	return count;
+}
+/* }}} */
+
+/* {{{ php_xattr_chunk_remove
+ * Remove chunks from to to - 1 of name, errors are ignored
+ */
+static void php_xattr_chunk_remove(php_xattr_target *target, const char *name, size_t from, size_t to)
+{
+	size_t name_len = strlen(name);
+	char *chunk_name = emalloc(name_len + XATTR_CHUNK_SUFFIX);
+
+	for (; from < to; from++) {
+		snprintf(chunk_name, name_len + XATTR_CHUNK_SUFFIX, "%s.%lu", name, (unsigned long) from);
+		php_xattr_target_removexattr(target, chunk_name);
+	}
+	efree(chunk_name);
+}
+/* }}} */
+
+/* {{{ php_xattr_target_store
+ * php_xattr_target_setxattr() splitting values longer than xattr.chunk_size.
+ * CREATE and REPLACE refer to name, chunks left over from a longer value
+ * are removed. Returns -1 with errno set on failure.
+ */
+static int php_xattr_target_store(php_xattr_target *target, const char *name, const char *value, size_t len, int options TSRMLS_DC)
+{
+	unsigned char manifest[XATTR_CHUNK_MANIFEST];
+	size_t chunk_size, count, old_count, name_len, i;
+	char *chunk_name;
+	int exists;
+
+	if (!XATTR_CHUNKING()) {
+		return php_xattr_target_setxattr(target, name, value, len, options);
+	}
+
+	old_count = php_xattr_chunk_count(target, name, &exists);
+	chunk_size = (size_t) XATTR_G(chunk_size);
+	if (len <= chunk_size) {
+		if (php_xattr_target_setxattr(target, name, value, len, options) == -1) {
+			return -1;
+		}
+		php_xattr_chunk_remove(target, name, 0, old_count);
+		return 0;
+	}
+
+	if (len > XATTR_CHUNK_MAX || chunk_size > UINT32_MAX) {
+		errno = E2BIG;
+		return -1;
+	}
+	if ((options & XATTR_XATTR_CREATE) && exists) {
+		errno = EEXIST;
+		return -1;
+	}
+	if ((options & XATTR_XATTR_REPLACE) && !exists) {
+		errno = XATTR_ENOATTR;
+		return -1;
+	}
+
+	/* The chunks first, so the manifest never refers to missing ones */
+	count = (len + chunk_size - 1) / chunk_size;
+	name_len = strlen(name);
+	chunk_name = emalloc(name_len + XATTR_CHUNK_SUFFIX);
+	for (i = 0; i < count; i++) {
+		snprintf(chunk_name, name_len + XATTR_CHUNK_SUFFIX, "%s.%lu", name, (unsigned long) i);
+		if (php_xattr_target_setxattr(target, chunk_name, value + i * chunk_size,
+			i + 1 < count ? chunk_size : len - i * chunk_size, 0) == -1) {
+			efree(chunk_name);
+			return -1;
+		}
+	}
+	efree(chunk_name);
+
+	memcpy(manifest, XATTR_CHUNK_MAGIC, 4);
+	php_xattr_le_put(manifest + 4, (uint64_t) len, 4);
+	php_xattr_le_put(manifest + 8, (uint64_t) chunk_size, 4);
+	php_xattr_le_put(manifest + 12, (uint64_t) count, 4);
+	if (php_xattr_target_setxattr(target, name, (const char *) manifest, sizeof(manifest), 0) == -1) {
+		return -1;
+	}
+
+	php_xattr_chunk_remove(target, name, count, old_count);
+	return 0;
+}
+/* }}} */
+
+/* {{{ php_xattr_target_remove
+ * php_xattr_target_removexattr() taking the chunks of a value along
+ */
+static int php_xattr_target_remove(php_xattr_target *target, const char *name TSRMLS_DC)
+{
+	size_t count;
+	int exists;
+
+	if (!XATTR_CHUNKING()) {
+		return php_xattr_target_removexattr(target, name);
+	}
+
+	count = php_xattr_chunk_count(target, name, &exists);
+	if (php_xattr_target_removexattr(target, name) == -1) {
+		return -1;
+	}
+	php_xattr_chunk_remove(target, name, 0, count);
+	return 0;
+}
+/* }}} */
+
+/* {{{ php_xattr_chunk_assemble
+ * Read the chunks a manifest refers to into one buffer, returns NULL with
+ * a warning if any of them is missing or doesn't have the expected size
+ */
+static xattr_string *php_xattr_chunk_assemble(php_xattr_target *target, const char *name, size_t total, size_t chunk_size, size_t count TSRMLS_DC)
+{
+	php_xattr_target chunks = *target;
+	xattr_uring *ring = NULL;
+	xattr_batch_op *ops = NULL;
+	xattr_string *out;
+	char *names, *p;
+	size_t stride = strlen(name) + XATTR_CHUNK_SUFFIX, i, want;
+	ssize_t len;
+	int opened = 0, ok = 1;
+
+	/* Several reads of the same file are cheaper through a descriptor */
+	if (target->fd == -1 && target->dirfd == -1 && count > 1
+		&& php_xattr_target_open(&chunks, target->path, target->flags) == 0 && chunks.fd != -1) {
+		opened = 1;
+	}
+
+	if (count >= XATTR_URING_MIN_BATCH && chunks.dirfd == -1) {
+		ring = php_xattr_uring(TSRMLS_C);
+	}
+	if (ring) {
+		ops = safe_emalloc(count, sizeof(*ops), 0);
+	}
+
+	out = xattr_string_alloc(total);
+	names = safe_emalloc(count, stride, 0);
+	for (i = 0, p = names; i < count; i++, p += stride) {
+		snprintf(p, stride, "%s.%lu", name, (unsigned long) i);
+		want = i + 1 < count ? chunk_size : total - i * chunk_size;
+		if (ring) {
+			ops[i].opcode = XATTR_BATCH_GET;
+			ops[i].fd = chunks.fd;
+			ops[i].path = chunks.path;
+			ops[i].name = p;
+			ops[i].value = xattr_string_val(out) + i * chunk_size;
+			ops[i].size = want;
+			ops[i].options = chunks.fd != -1 ? 0 : chunks.flags;
+		} else if (php_xattr_target_getxattr(&chunks, p, xattr_string_val(out) + i * chunk_size, want) != (ssize_t) want) {
+			ok = 0;
+			break;
+		}
+	}
+
+	if (ring) {
+		xattr_batch_run(ring, ops, count);
+		for (i = 0; i < count; i++) {
+			want = i + 1 < count ? chunk_size : total - i * chunk_size;
+			len = ops[i].result;
+			if (len != (ssize_t) want) {
+				ok = 0;
+				break;
+			}
+		}
+		efree(ops);
+	}
+
+	if (!ok) {
+		if (php_xattr_error(EIO TSRMLS_CC)) {
+			php_error(E_WARNING, "%s Chunk %s of attribute %s is missing or damaged", get_active_function_name(TSRMLS_C), names + i * stride, name);
+		}
+		xattr_string_free(out);
+		out = NULL;
+	}
+	efree(names);
+	if (opened) {
+		php_xattr_target_close(&chunks);
+	}
+	return out;
+}
+/* }}} */
+
+/* {{{ php_xattr_decode
+ * Swap a value just read for its original if it was stored chunked or
+ * compressed. Returns FAILURE, with the value released, if the chunks of
+ * a chunked one can't be read.
+ */
+static int php_xattr_decode(php_xattr_target *target, const char *name, xattr_string **value, ssize_t *len TSRMLS_DC)
+{
+	xattr_string *orig;
+	size_t orig_len, chunk_size, count;
+
+	if (php_xattr_chunk_manifest(xattr_string_val(*value), (size_t) *len, &orig_len, &chunk_size, &count) == SUCCESS) {
+		orig = php_xattr_chunk_assemble(target, name, orig_len, chunk_size, count TSRMLS_CC);
+		xattr_string_free(*value);
+		*value = orig;
+		if (!orig) {
+			return FAILURE;
+		}
+		*len = (ssize_t) orig_len;
+	}
+
+	orig = php_xattr_inflate(xattr_string_val(*value), (size_t) *len, &orig_len TSRMLS_CC);
+	if (orig) {
+		xattr_string_free(*value);
+		*value = orig;
+		*len = (ssize_t) orig_len;
+	}
+	return SUCCESS;
+}
+/* }}} */
+
+/* {{{ php_xattr_target_list
+ * Read the list of names into buffer, a XATTR_BUFFER_SIZE bytes scratch area
+ * of the caller. Longer lists go to an emalloc'ed buffer instead. *namebuf
+ * points to the list either way and has to be released with
+ * php_xattr_target_list_free(). Returns the size of the list or -1.
+ */
+static ssize_t php_xattr_target_list(php_xattr_target *target, char *buffer, char **namebuf)
+{
+	ssize_t size = XATTR_BUFFER_SIZE, len, retry;
+
+	*namebuf = buffer;
+	for (;;) {
+		len = php_xattr_target_listxattr(target, *namebuf, size);
+		retry = php_xattr_target_retry_size(target, NULL, len, size);
+		if (retry <= 0) {
+			break;
+		}
+		size = retry;
+		*namebuf = *namebuf == buffer ? emalloc(size) : erealloc(*namebuf, size);
+	}
+
+	if (retry < 0) {
+		if (*namebuf != buffer) {
+			efree(*namebuf);
+		}
+		return -1;
+	}
+	return len;
+}
+/* }}} */
+
+static void php_xattr_target_list_free(char *buffer, char *namebuf)
+{
+	if (namebuf != buffer) {
+		efree(namebuf);
+	}
+}
+
+/* A chunked value in a list of names, see php_xattr_list_chunked() */
+typedef struct {
+	const char *name;
+	size_t name_len;
+	size_t count;
+} php_xattr_chunked;
+
+/* {{{ php_xattr_list_chunked
+ * Find the chunked values in a list of names, so their chunks can be left
+ * out of it. Every chunked value has a chunk 0, so only names ending in
+ * ".0" lead to a look at what precedes it. With chunking off the chunks
+ * are listed like any other name, nothing is looked at. Returns how many
+ * were found, *chunked is an emalloc'ed array of them if any.
+ */
+static size_t php_xattr_list_chunked(php_xattr_target *target, const char *namebuf, size_t list_len, php_xattr_chunked **chunked TSRMLS_DC)
+{
+	const char *p, *end;
+	char *base;
+	size_t len, count, found = 0, size = 0;
+	int exists;
+
+	*chunked = NULL;
+	if (!XATTR_CHUNKING()) {
+		return 0;
+	}
+	for (p = namebuf, end = namebuf + list_len; p < end; p += len + 1) {
+		len = strlen(p);
+		if (len < 3 || p[len - 2] != '.' || p[len - 1] != '0') {
+			continue;
+		}
+		base = estrndup(p, len - 2);
+		count = php_xattr_chunk_count(target, base, &exists);
+		efree(base);
+		if (!count) {
+			continue;
+		}
+		if (found == size) {
+			size = size ? size * 2 : 4;
+			*chunked = safe_erealloc(*chunked, size, sizeof(**chunked), 0);
+		}
+		(*chunked)[found].name = p;
+		(*chunked)[found].name_len = len - 2;
+		(*chunked)[found].count = count;
+		found++;
+	}
+	return found;
+}
+/* }}} */
+
+/* {{{ php_xattr_is_chunk
+ * Whether name is one of the chunks php_xattr_list_chunked() found
+ */
+static int php_xattr_is_chunk(const char *name, size_t len, const php_xattr_chunked *chunked, size_t found)
+{
+	const char *dot = name + len;
+	unsigned long index;
+	size_t i;
+
+	while (dot > name && dot[-1] >= '0' && dot[-1] <= '9') {
+		dot--;
+	}
+	if (dot == name + len || dot == name || dot[-1] != '.') {
+		return 0;
+	}
+	index = strtoul(dot, NULL, 10);
+	for (i = 0; i < found; i++) {
+		if (chunked[i].name_len == (size_t) (dot - 1 - name) && index < chunked[i].count
+			&& !memcmp(chunked[i].name, name, chunked[i].name_len)) {
+			return 1;
+		}
+	}
+	return 0;
+}
+/* }}} */
+
+/* {{{ php_xattr_list_to_array
+ * Turn a list of names of target into an array, every name is copied once
+ * straight out of the list. The chunks of chunked values are left out.
+ */
+static void php_xattr_list_to_array(zval *array, php_xattr_target *target, const char *namebuf, ssize_t list_len TSRMLS_DC)
+{
+	php_xattr_chunked *chunked;
+	const char *p, *end;
+	size_t len, found;
+
+	found = php_xattr_list_chunked(target, namebuf, (size_t) list_len, &chunked TSRMLS_CC);
+	array_init(array);
+	for (p = namebuf, end = namebuf + list_len; p < end; p += len + 1) {
+		len = strlen(p);
+		if (found && php_xattr_is_chunk(p, len, chunked, found)) {
+			continue;
+		}
+		xattr_add_next_index_stringl(array, p, len);
+	}
+	if (chunked) {
+		efree(chunked);
+	}
+}
+/* }}} */
+
+/* {{{ proto bool xattr_set(string path, string name, string value [, int flags])
+   Set an extended attribute of file */
+PHP_FUNCTION(xattr_set)
+{
+	char *attr_name = NULL;
+	char *attr_value = NULL;
+	char *path = NULL;
+	char *packed;
+	int error;
+	xattr_strlen_t tmp, value_len;
+	xattr_long_t flags = 0;
+	php_xattr_target target;
+	size_t packed_len;
+
+	XATTR_FUNCTION_ENTER();
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "sss|l", &path, &tmp, &attr_name, &tmp, &attr_value, &value_len, &flags) == FAILURE) {
+		return;
+	}
+	XATTR_QUIET_FLAG(flags);
+
+	if (php_xattr_check_basedir(path TSRMLS_CC)) {
+		RETURN_FALSE;
+	}
+	
+	/* Ensure that only allowed bits are set */
+	flags &= ATTR_ROOT | XATTR_XATTR_NOFOLLOW | XATTR_XATTR_CREATE | XATTR_XATTR_REPLACE; 
+
+	packed = php_xattr_deflate(attr_value, value_len, &packed_len TSRMLS_CC);
+	if (packed) {
+		attr_value = packed;
+		value_len = (xattr_strlen_t) packed_len;
+	}
+
+	/* CREATE and REPLACE depend on what's there now, so they can't wait */
+	if (XATTR_G(write_behind) && !(flags & (XATTR_XATTR_CREATE | XATTR_XATTR_REPLACE))
+		&& php_xattr_queue_add(path, flags, attr_name, tmp, attr_value, value_len TSRMLS_CC) == SUCCESS) {
+		error = 0;
+	} else {
+		php_xattr_queue_sync(path TSRMLS_CC);
+
+		/* Attempt to set an attribute, warn if failed. */ 
+		php_xattr_target_path(&target, path, flags & (ATTR_ROOT | XATTR_XATTR_NOFOLLOW));
+		error = php_xattr_target_store(&target, attr_name, attr_value, value_len, flags & (XATTR_XATTR_CREATE | XATTR_XATTR_REPLACE) TSRMLS_CC);
+		if (error == -1) {
+			php_xattr_warn(errno, path TSRMLS_CC);
+		} else {
+			php_xattr_cache_forget(path, -1, flags, attr_name TSRMLS_CC);
+		}
+	}
+
+	if (packed) {
+		efree(packed);
+	}
+	RETURN_BOOL(error != -1);
+}
+/* }}} */
+
+/* {{{ proto string xattr_get(string path, string name [, int flags])
+   Returns a value of an extended attribute */
+PHP_FUNCTION(xattr_get)
+{
+	char *attr_name = NULL;
+	char *path = NULL;
+	xattr_string *attr_value;
+	xattr_strlen_t tmp;
+	xattr_long_t flags = 0;
+	php_xattr_target target;
+	char scratch[XATTR_SHM_DATA_MAX];
+	const char *data;
+	struct stat sb;
+	ssize_t value_len;
+	size_t orig_len;
+	int cached, err;
+
+	XATTR_FUNCTION_ENTER();
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "ss|l", &path, &tmp, &attr_name, &tmp, &flags) == FAILURE) {
+		return;
+	}
+	XATTR_QUIET_FLAG(flags);
+
+	if (php_xattr_check_basedir(path TSRMLS_CC)) {
+		RETURN_FALSE;
+	}
+	php_xattr_queue_sync(path TSRMLS_CC);
+	
+	/* Ensure that only allowed bits are set */
+	flags &= ATTR_ROOT | XATTR_XATTR_NOFOLLOW; 
+
+	cached = php_xattr_cache_stat(path, flags, &sb TSRMLS_CC) == 0;
+	if (cached && php_xattr_cache_find(XATTR_CACHE_VALUE, &sb, flags, attr_name, tmp, scratch, &data, &value_len TSRMLS_CC)) {
+		if (value_len >= 0) {
+			if (value_len == XATTR_CHUNK_MANIFEST && !memcmp(data, XATTR_CHUNK_MAGIC, 4)) {
+				/* Only the manifest is cached, the chunks are read again */
+				attr_value = xattr_string_alloc(value_len);
+				memcpy(xattr_string_val(attr_value), data, value_len);
+				php_xattr_target_path(&target, path, flags);
+				if (php_xattr_decode(&target, attr_name, &attr_value, &value_len TSRMLS_CC) == FAILURE) {
+					RETURN_FALSE;
+				}
+				xattr_zval_string(return_value, attr_value, value_len);
+				return;
+			}
+			if ((attr_value = php_xattr_inflate(data, value_len, &orig_len TSRMLS_CC)) != NULL) {
+				xattr_zval_string(return_value, attr_value, orig_len);
+				return;
+			}
+			XATTR_RETVAL_STRINGL(data, value_len);
+			return;
+		}
+		php_xattr_warn(XATTR_ENOATTR, path TSRMLS_CC);
+		RETURN_FALSE;
+	}
+	
+	php_xattr_target_path(&target, path, flags);
+	value_len = php_xattr_target_read(&target, attr_name, &attr_value);
+	if (value_len >= 0) {
+		if (cached) {
+			php_xattr_cache_store(XATTR_CACHE_VALUE, path, &sb, flags, attr_name, tmp, xattr_string_val(attr_value), value_len TSRMLS_CC);
+		}
+		if (php_xattr_decode(&target, attr_name, &attr_value, &value_len TSRMLS_CC) == FAILURE) {
+			RETURN_FALSE;
+		}
+		xattr_zval_string(return_value, attr_value, value_len);
+		return;
+	}
+
+	err = errno;
+	if (cached && err == XATTR_ENOATTR) {
+		php_xattr_cache_store(XATTR_CACHE_VALUE, path, &sb, flags, attr_name, tmp, NULL, -1 TSRMLS_CC);
+	}
+	php_xattr_warn(err, path TSRMLS_CC);
+	RETURN_FALSE;
+}
+/* }}} */
+
+/* {{{ proto bool xattr_supported(string path [, int flags])
+   Checks if filesystem supports extended attributes */
+PHP_FUNCTION(xattr_supported)
+{
+	char *path = NULL;
+	int error;
+	xattr_strlen_t tmp;
+	xattr_long_t flags = 0;
+
+	XATTR_FUNCTION_ENTER();
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "s|l", &path, &tmp, &flags) == FAILURE) {
+		return;
+	}
+	XATTR_QUIET_FLAG(flags);
+	flags &= ~XATTR_QUIET;
+	
+	if (php_xattr_check_basedir(path TSRMLS_CC)) {
+		RETURN_NULL();
+	}
+	
+	/* Is "test" a good name? */
+	error = xattr_getxattr(path, "user.test", NULL, 0 ,0, flags);
+
+	if (error >= 0)
+		RETURN_TRUE;
+	
+	if (errno == ENOTSUP) {
+		RETURN_FALSE;
+	}
+	if (!php_xattr_error(errno TSRMLS_CC)) {
+		RETURN_NULL();
+	}
+
+	switch (errno) {
+		case ENOENT:
+		case ENOTDIR:
+			php_error(E_WARNING, "%s File %s doesn't exists", get_active_function_name(TSRMLS_C), path);
+			break;
+		case EACCES:
+			php_error(E_WARNING, "%s Permission denied", get_active_function_name(TSRMLS_C));
+			break;
+	}
+	
+	RETURN_NULL();
+}
+/* }}} */
+
+/* {{{ proto string xattr_remove(string path, string name [, int flags])
+   Remove an extended attribute of file */
+PHP_FUNCTION(xattr_remove)
+{
+	char *attr_name = NULL;
+	char *path = NULL;
+	int error;
+	xattr_strlen_t tmp;
+	xattr_long_t flags = 0;
+	php_xattr_target target;
+	
+	XATTR_FUNCTION_ENTER();
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "ss|l", &path, &tmp, &attr_name, &tmp, &flags) == FAILURE) {
+		return;
+	}
+	XATTR_QUIET_FLAG(flags);
+	
+	if (php_xattr_check_basedir(path TSRMLS_CC)) {
+		RETURN_FALSE;
+	}
+	php_xattr_queue_sync(path TSRMLS_CC);
+	
+	/* Ensure that only allowed bits are set */
+	flags &= ATTR_ROOT | XATTR_XATTR_NOFOLLOW; 
+	
+	/* Attempt to remove an attribute, warn if failed. */ 
+	php_xattr_target_path(&target, path, flags);
+	error = php_xattr_target_remove(&target, attr_name TSRMLS_CC);
+	if (error == -1) {
+		php_xattr_warn(errno, path TSRMLS_CC);
+		RETURN_FALSE;
+	}
+
+	php_xattr_cache_forget(path, -1, flags, attr_name TSRMLS_CC);
+	RETURN_TRUE;
+}
+/* }}} */
+
+/* {{{ proto array xattr_list(string path [, int flags])
+   Get list of extended attributes of file */
+PHP_FUNCTION(xattr_list)
+{
+	char buffer[XATTR_BUFFER_SIZE], *namebuf;
+	char *path = NULL;
+	xattr_strlen_t tmp;
+	xattr_long_t flags = 0;
+	php_xattr_target target;
+	char scratch[XATTR_SHM_DATA_MAX];
+	const char *data;
+	struct stat sb;
+	ssize_t list_len;
+	int cached;
+	
+	XATTR_FUNCTION_ENTER();
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "s|l", &path, &tmp, &flags) == FAILURE) {
+		return;
+	}
+	XATTR_QUIET_FLAG(flags);
+	
+	if (php_xattr_check_basedir(path TSRMLS_CC)) {
+		RETURN_FALSE;
+	}
+	php_xattr_queue_sync(path TSRMLS_CC);
+
+	/* Ensure that only allowed bits are set */
+	flags &= ATTR_ROOT | XATTR_XATTR_NOFOLLOW; 
+
+	cached = php_xattr_cache_stat(path, flags, &sb TSRMLS_CC) == 0;
+	php_xattr_target_path(&target, path, flags);
+	if (cached && php_xattr_cache_find(XATTR_CACHE_LIST, &sb, flags, "", 0, scratch, &data, &list_len TSRMLS_CC)) {
+		php_xattr_list_to_array(return_value, &target, data, list_len TSRMLS_CC);
+		return;
+	}
+
+	list_len = php_xattr_target_list(&target, buffer, &namebuf);
+	if (list_len < 0) {
+		php_xattr_warn(errno, path TSRMLS_CC);
+		RETURN_FALSE;
+	}
+
+	if (cached) {
+		php_xattr_cache_store(XATTR_CACHE_LIST, path, &sb, flags, "", 0, namebuf, list_len TSRMLS_CC);
+	}
+	php_xattr_list_to_array(return_value, &target, namebuf, list_len TSRMLS_CC);
+	php_xattr_target_list_free(buffer, namebuf);
+}
+/* }}} */   
+
+/* {{{ proto array xattr_get_multi(string path, array names [, int flags])
+   Returns values of several extended attributes of file, false for every missing one */
+PHP_FUNCTION(xattr_get_multi)
+{
+	char *path = NULL;
+	zval *names, *entry;
+	xattr_tmp_string *tmp;
+	xattr_string **values;
+	const char **attr_names;
+	xattr_strlen_t path_len;
+	xattr_long_t flags = 0;
+	php_xattr_target target;
+	ssize_t *lens;
+	size_t i, count;
+
+	XATTR_FUNCTION_ENTER();
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "sa|l", &path, &path_len, &names, &flags) == FAILURE) {
+		return;
+	}
+	XATTR_QUIET_FLAG(flags);
+
+	if (php_xattr_check_basedir(path TSRMLS_CC)) {
+		RETURN_FALSE;
+	}
+	php_xattr_queue_sync(path TSRMLS_CC);
+
+	/* Ensure that only allowed bits are set */
+	flags &= ATTR_ROOT | XATTR_XATTR_NOFOLLOW;
+
+	if (php_xattr_target_open(&target, path, flags) == -1) {
+		php_xattr_warn(errno, path TSRMLS_CC);
+		RETURN_FALSE;
+	}
+
+	count = zend_hash_num_elements(Z_ARRVAL_P(names));
+	tmp = safe_emalloc(count, sizeof(*tmp), 0);
+	attr_names = safe_emalloc(count, sizeof(*attr_names), 0);
+	values = safe_emalloc(count, sizeof(*values), 0);
+	lens = safe_emalloc(count, sizeof(*lens), 0);
+
+	i = 0;
+	XATTR_HASH_FOREACH_VAL(Z_ARRVAL_P(names), entry) {
+		xattr_tmp_string_init(&tmp[i], entry);
+		attr_names[i] = xattr_tmp_string_val(&tmp[i]);
+		i++;
+	} XATTR_HASH_FOREACH_END();
+
+	php_xattr_target_read_batch(&target, attr_names, count, values, lens TSRMLS_CC);
+
+	array_init(return_value);
+	for (i = 0; i < count; i++) {
+		/* Missing or unreadable attributes are reported as false, not as warnings */
+		if (lens[i] >= 0 && php_xattr_decode(&target, attr_names[i], &values[i], &lens[i] TSRMLS_CC) == SUCCESS) {
+			xattr_add_assoc_string(return_value, attr_names[i], xattr_tmp_string_len(&tmp[i]), values[i], lens[i]);
+		} else {
+			add_assoc_bool_ex(return_value, attr_names[i], XATTR_ASSOC_KEYLEN(xattr_tmp_string_len(&tmp[i])), 0);
+		}
+		xattr_tmp_string_free(&tmp[i]);
+	}
+
+	efree(lens);
+	efree(values);
+	efree(attr_names);
+	efree(tmp);
+	php_xattr_target_close(&target);
+}
+/* }}} */
+
+/* {{{ proto array xattr_get_all(string path [, string prefix [, int flags]])
+   Returns all extended attributes of file whose names begin with prefix */
+PHP_FUNCTION(xattr_get_all)
+{
+	char buffer[XATTR_BUFFER_SIZE], *namebuf, *p, *end;
+	char *path = NULL, *prefix = NULL;
+	const char **attr_names;
+	xattr_string **values;
+	xattr_strlen_t path_len, prefix_len = 0;
+	xattr_long_t flags = 0;
+	php_xattr_target target;
+	php_xattr_chunked *chunked;
+	ssize_t list_len, *lens;
+	size_t len, i, count, found;
+
+	XATTR_FUNCTION_ENTER();
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "s|sl", &path, &path_len, &prefix, &prefix_len, &flags) == FAILURE) {
+		return;
+	}
+	XATTR_QUIET_FLAG(flags);
+
+	if (php_xattr_check_basedir(path TSRMLS_CC)) {
+		RETURN_FALSE;
+	}
+	php_xattr_queue_sync(path TSRMLS_CC);
+
+	/* Ensure that only allowed bits are set */
+	flags &= ATTR_ROOT | XATTR_XATTR_NOFOLLOW;
+
+	if (php_xattr_target_open(&target, path, flags) == -1
+		|| (list_len = php_xattr_target_list(&target, buffer, &namebuf)) < 0) {
+		php_xattr_warn(errno, path TSRMLS_CC);
+		php_xattr_target_close(&target);
+		RETURN_FALSE;
+	}
+
+	/* A list of n names can't hold more than n / 2 + 1 of them */
+	attr_names = safe_emalloc(list_len / 2 + 1, sizeof(*attr_names), 0);
+	found = php_xattr_list_chunked(&target, namebuf, (size_t) list_len, &chunked TSRMLS_CC);
+	count = 0;
+	for (p = namebuf, end = namebuf + list_len; p < end; p += len + 1) {
+		len = strlen(p);
+
+		if (prefix_len && strncmp(p, prefix, prefix_len)) {
+			continue;
+		}
+		/* Chunks come with the value they belong to */
+		if (found && php_xattr_is_chunk(p, len, chunked, found)) {
+			continue;
+		}
+		attr_names[count++] = p;
+	}
+	if (chunked) {
+		efree(chunked);
+	}
+
+	values = safe_emalloc(count, sizeof(*values), 0);
+	lens = safe_emalloc(count, sizeof(*lens), 0);
+	php_xattr_target_read_batch(&target, attr_names, count, values, lens TSRMLS_CC);
+
+	array_init(return_value);
+	for (i = 0; i < count; i++) {
+		/* The attribute may have been removed since it was listed, skip it then */
+		if (lens[i] >= 0 && php_xattr_decode(&target, attr_names[i], &values[i], &lens[i] TSRMLS_CC) == SUCCESS) {
+			xattr_add_assoc_string(return_value, attr_names[i], strlen(attr_names[i]), values[i], lens[i]);
+		}
+	}
+
+	efree(lens);
+	efree(values);
+	efree(attr_names);
+	php_xattr_target_list_free(buffer, namebuf);
+	php_xattr_target_close(&target);
+}
+/* }}} */
+
+/* {{{ proto array xattr_set_multi(string path, array values [, int flags [, array key_flags]])
+   Set several extended attributes of file, returns whether each one was set */
+PHP_FUNCTION(xattr_set_multi)
+{
+	char *path = NULL, *name, *packed;
+	zval *values, *key_flags = NULL, *entry, *option;
+	xattr_tmp_string value;
+	xattr_strlen_t path_len;
+	xattr_long_t flags = 0;
+	xattr_ulong_t idx = 0;
+	php_xattr_target target;
+	struct {
+		const char *name;
+		size_t name_len;
+		xattr_string *value;
+		ssize_t len;		/* -1 if the attribute didn't exist */
+	} *undo = NULL;
+	size_t name_len, done = 0, packed_len, i;
+	int options, failed = 0, rv;
+
+	XATTR_FUNCTION_ENTER();
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "sa|la!", &path, &path_len, &values, &flags, &key_flags) == FAILURE) {
+		return;
+	}
+	XATTR_QUIET_FLAG(flags);
+
+	if (php_xattr_check_basedir(path TSRMLS_CC)) {
+		RETURN_FALSE;
+	}
+	php_xattr_queue_sync(path TSRMLS_CC);
+
+	/* Ensure that only allowed bits are set */
+	flags &= XATTR_XATTR_NOFOLLOW | XATTR_XATTR_CREATE | XATTR_XATTR_REPLACE | XATTR_ROLLBACK;
+
+	if (php_xattr_target_open(&target, path, flags & XATTR_XATTR_NOFOLLOW) == -1) {
+		php_xattr_warn(errno, path TSRMLS_CC);
+		RETURN_FALSE;
+	}
+
+	if (flags & XATTR_ROLLBACK) {
+		undo = safe_emalloc(zend_hash_num_elements(Z_ARRVAL_P(values)), sizeof(*undo), 0);
+	}
+
+	array_init(return_value);
+	XATTR_HASH_FOREACH_KEY_VAL(Z_ARRVAL_P(values), idx, name, name_len, entry) {
+		/* Attribute names are never numbers, nothing further is tried when rolling back */
+		if (!name || (failed && undo)) {
+			if (name) {
+				add_assoc_bool_ex(return_value, name, XATTR_ASSOC_KEYLEN(name_len), 0);
+			} else {
+				add_index_bool(return_value, idx, 0);
+			}
+			failed = 1;
+			continue;
+		}
+
+		options = (int) (flags & (XATTR_XATTR_CREATE | XATTR_XATTR_REPLACE));
+		if (key_flags && (option = xattr_hash_str_find(Z_ARRVAL_P(key_flags), name, name_len)) != NULL) {
+			options = (int) (xattr_zval_get_long(option) & (XATTR_XATTR_CREATE | XATTR_XATTR_REPLACE));
+		}
+
+		if (undo) {
+			undo[done].name = name;
+			undo[done].name_len = name_len;
+			undo[done].len = php_xattr_target_read(&target, name, &undo[done].value);
+			/* Kept decoded, the chunks of the old value are gone once it's replaced */
+			if (undo[done].len >= 0
+				&& php_xattr_decode(&target, name, &undo[done].value, &undo[done].len TSRMLS_CC) == FAILURE) {
+				undo[done].len = -1;
+				errno = EIO;
+			}
+			if (undo[done].len == -1 && errno != XATTR_ENOATTR) {
+				/* What can't be saved can't be restored either */
+				add_assoc_bool_ex(return_value, name, XATTR_ASSOC_KEYLEN(name_len), 0);
+				failed = 1;
+				continue;
+			}
+		}
+
+		xattr_tmp_string_init(&value, entry);
+		packed = php_xattr_deflate(xattr_tmp_string_val(&value), xattr_tmp_string_len(&value), &packed_len TSRMLS_CC);
+		if (packed) {
+			rv = php_xattr_target_store(&target, name, packed, packed_len, options TSRMLS_CC);
+			efree(packed);
+		} else {
+			rv = php_xattr_target_store(&target, name, xattr_tmp_string_val(&value), xattr_tmp_string_len(&value), options TSRMLS_CC);
+		}
+		xattr_tmp_string_free(&value);
+
+		if (rv == -1) {
+			if (undo && undo[done].len >= 0) {
+				xattr_string_free(undo[done].value);
+			}
+			failed = 1;
+		} else {
+			done++;
+			php_xattr_cache_forget(path, target.fd, target.flags, name TSRMLS_CC);
+		}
+		add_assoc_bool_ex(return_value, name, XATTR_ASSOC_KEYLEN(name_len), rv != -1);
+	} XATTR_HASH_FOREACH_KEY_END();
+
+	if (undo) {
+		/* Put back what was there before, latest write first */
+		for (i = done; i-- > 0; ) {
+			if (failed) {
+				if (undo[i].len >= 0) {
+					php_xattr_target_store(&target, undo[i].name, xattr_string_val(undo[i].value), undo[i].len, 0 TSRMLS_CC);
+				} else {
+					php_xattr_target_remove(&target, undo[i].name TSRMLS_CC);
+				}
+				php_xattr_cache_forget(path, target.fd, target.flags, undo[i].name TSRMLS_CC);
+				add_assoc_bool_ex(return_value, undo[i].name, XATTR_ASSOC_KEYLEN(undo[i].name_len), 0);
+			}
+			if (undo[i].len >= 0) {
+				xattr_string_free(undo[i].value);
+			}
+		}
+		efree(undo);
+	}
+	php_xattr_target_close(&target);
+}
+/* }}} */
+
+/* {{{ proto mixed xattr_bundle_get(string path, string bundle [, string field [, int flags]])
+   Returns one field of a bundle attribute, or all of them as an array */
+PHP_FUNCTION(xattr_bundle_get)
+{
+	char *path = NULL, *bundle = NULL, *field = NULL;
+	xattr_string *value;
+	xattr_strlen_t tmp, field_len = 0;
+	xattr_long_t flags = 0;
+	php_xattr_target target;
+	xattr_bundle_field found;
+	ssize_t value_len;
+	long count, i;
+
+	XATTR_FUNCTION_ENTER();
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "ss|s!l", &path, &tmp, &bundle, &tmp, &field, &field_len, &flags) == FAILURE) {
+		return;
+	}
+	XATTR_QUIET_FLAG(flags);
+
+	if (php_xattr_check_basedir(path TSRMLS_CC)) {
+		RETURN_FALSE;
+	}
+	php_xattr_queue_sync(path TSRMLS_CC);
+
+	/* Ensure that only allowed bits are set */
+	flags &= ATTR_ROOT | XATTR_XATTR_NOFOLLOW;
+
+	/* The whole record comes with one call, fields are then only looked up */
+	php_xattr_target_path(&target, path, flags);
+	value_len = php_xattr_target_read(&target, bundle, &value);
+	if (value_len < 0) {
+		php_xattr_warn(errno, path TSRMLS_CC);
+		RETURN_FALSE;
+	}
+	if (php_xattr_decode(&target, bundle, &value, &value_len TSRMLS_CC) == FAILURE) {
+		RETURN_FALSE;
+	}
+
+	if (field) {
+		switch (xattr_bundle_find(xattr_string_val(value), value_len, field, field_len, &found)) {
+			case 1:
+				XATTR_RETVAL_STRINGL(found.value, found.value_len);
+				break;
+			case 0:
+				RETVAL_FALSE;
+				break;
+			default:
+				if (php_xattr_error(EINVAL TSRMLS_CC)) {
+					php_error(E_WARNING, "%s Attribute %s is not a bundle", get_active_function_name(TSRMLS_C), bundle);
+				}
+				RETVAL_FALSE;
+		}
+		xattr_string_free(value);
+		return;
+	}
+
+	count = xattr_bundle_count(xattr_string_val(value), value_len);
+	if (count < 0) {
+		if (php_xattr_error(EINVAL TSRMLS_CC)) {
+			php_error(E_WARNING, "%s Attribute %s is not a bundle", get_active_function_name(TSRMLS_C), bundle);
+		}
+		xattr_string_free(value);
+		RETURN_FALSE;
+	}
+
+	array_init(return_value);
+	for (i = 0; i < count; i++) {
+		xattr_bundle_field_at(xattr_string_val(value), (size_t) i, &found);
+		xattr_add_assoc_stringl(return_value, found.name, found.name_len, found.value, found.value_len);
+	}
+	xattr_string_free(value);
+}
+/* }}} */
+
+/* {{{ proto bool xattr_bundle_set(string path, string bundle, array fields [, int flags])
+   Set fields of a bundle attribute, fields set to null are removed */
+PHP_FUNCTION(xattr_bundle_set)
+{
+	char *path = NULL, *bundle = NULL, *name, *out;
+	zval *fields, *entry;
+	xattr_string *value = NULL;
+	xattr_tmp_string *strs;
+	xattr_strlen_t tmp;
+	xattr_long_t flags = 0;
+	xattr_ulong_t idx;
+	php_xattr_target target;
+	xattr_bundle_field *merged;
+	ssize_t value_len;
+	size_t name_len, count = 0, nstrs = 0, size, i;
+	long old_count = 0;
+	int rv;
+
+	XATTR_FUNCTION_ENTER();
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "ssa|l", &path, &tmp, &bundle, &tmp, &fields, &flags) == FAILURE) {
+		return;
+	}
+	XATTR_QUIET_FLAG(flags);
+
+	if (php_xattr_check_basedir(path TSRMLS_CC)) {
+		RETURN_FALSE;
+	}
+	php_xattr_queue_sync(path TSRMLS_CC);
+
+	/* Ensure that only allowed bits are set */
+	flags &= ATTR_ROOT | XATTR_XATTR_NOFOLLOW;
+
+	php_xattr_target_path(&target, path, flags);
+	value_len = php_xattr_target_read(&target, bundle, &value);
+	if (value_len < 0) {
+		if (errno != XATTR_ENOATTR) {
+			php_xattr_warn(errno, path TSRMLS_CC);
+			RETURN_FALSE;
+		}
+		value = NULL;
+	} else if (php_xattr_decode(&target, bundle, &value, &value_len TSRMLS_CC) == FAILURE) {
+		RETURN_FALSE;
+	} else if ((old_count = xattr_bundle_count(xattr_string_val(value), value_len)) < 0) {
+		if (php_xattr_error(EINVAL TSRMLS_CC)) {
+			php_error(E_WARNING, "%s Attribute %s is not a bundle", get_active_function_name(TSRMLS_C), bundle);
+		}
+		xattr_string_free(value);
+		RETURN_FALSE;
+	}
+
+	merged = safe_emalloc((size_t) old_count + zend_hash_num_elements(Z_ARRVAL_P(fields)), sizeof(*merged), 0);
+	strs = safe_emalloc(zend_hash_num_elements(Z_ARRVAL_P(fields)), sizeof(*strs), 0);
+
+	/* Fields which aren't given keep their value */
+	for (i = 0; i < (size_t) old_count; i++) {
+		xattr_bundle_field_at(xattr_string_val(value), i, &merged[count]);
+		if (!xattr_hash_str_find(Z_ARRVAL_P(fields), merged[count].name, merged[count].name_len)) {
+			count++;
+		}
+	}
+
+	XATTR_HASH_FOREACH_KEY_VAL(Z_ARRVAL_P(fields), idx, name, name_len, entry) {
+		if (!name || Z_TYPE_P(entry) == IS_NULL) {
+			continue;
+		}
+		xattr_tmp_string_init(&strs[nstrs], entry);
+		merged[count].name = name;
+		merged[count].name_len = name_len;
+		merged[count].value = xattr_tmp_string_val(&strs[nstrs]);
+		merged[count].value_len = xattr_tmp_string_len(&strs[nstrs]);
+		nstrs++;
+		count++;
+	} XATTR_HASH_FOREACH_KEY_END();
+
+	if (count) {
+		xattr_bundle_sort(merged, count);
+		size = xattr_bundle_size(merged, count);
+		if (!size) {
+			rv = -1;
+			errno = E2BIG;
+		} else {
+			out = emalloc(size);
+			xattr_bundle_encode(merged, count, out);
+			rv = php_xattr_target_store(&target, bundle, out, size, 0 TSRMLS_CC);
+			efree(out);
+		}
+	} else {
+		/* Nothing left, don't keep an empty record around */
+		rv = value ? php_xattr_target_remove(&target, bundle TSRMLS_CC) : 0;
+	}
+	if (rv == -1) {
+		php_xattr_warn(errno, path TSRMLS_CC);
+	} else {
+		php_xattr_cache_forget(path, -1, flags, bundle TSRMLS_CC);
+	}
+
+	for (i = 0; i < nstrs; i++) {
+		xattr_tmp_string_free(&strs[i]);
+	}
+	efree(strs);
+	efree(merged);
+	if (value) {
+		xattr_string_free(value);
+	}
+	RETURN_BOOL(rv != -1);
+}
+/* }}} */
+
+/*
+ * Numbers stored as fixed width little endian binary, 8 bytes for
+ * integers and doubles. The codes of xattr_get_packed() are those pack()
+ * uses for the same little endian layouts, so pack() can write what
+ * xattr_get_packed() reads.
+ */
+#define XATTR_NUMBER_SIZE	8
+
+static double php_xattr_le_double(uint64_t bits)
+{
+	double d;
+
+	memcpy(&d, &bits, sizeof(d));
+	return d;
+}
+
+static uint64_t php_xattr_double_bits(double d)
+{
+	uint64_t bits;
+
+	memcpy(&bits, &d, sizeof(bits));
+	return bits;
+}
+
+/* {{{ php_xattr_read_number
+ * Read an attribute which has to be exactly XATTR_NUMBER_SIZE bytes long
+ */
+static int php_xattr_read_number(php_xattr_target *target, const char *name, unsigned char *buf TSRMLS_DC)
+{
+	ssize_t len = php_xattr_target_getxattr(target, name, buf, XATTR_NUMBER_SIZE);
+
+	if (len == XATTR_NUMBER_SIZE) {
+		return SUCCESS;
+	}
+	if (len >= 0 || errno == ERANGE) {
+		if (php_xattr_error(EINVAL TSRMLS_CC)) {
+			php_error(E_WARNING, "%s Attribute %s is not a number stored in %d bytes", get_active_function_name(TSRMLS_C), name, XATTR_NUMBER_SIZE);
+		}
+	} else {
+		php_xattr_warn(errno, target->path TSRMLS_CC);
+	}
+	return FAILURE;
+}
+/* }}} */
+
+/* {{{ php_xattr_write_number
+ * Returns FAILURE with errno set and leaves warning about it to the caller
+ */
+static int php_xattr_write_number(php_xattr_target *target, const char *name, uint64_t bits, int options TSRMLS_DC)
+{
+	unsigned char buf[XATTR_NUMBER_SIZE];
+
+	php_xattr_le_put(buf, bits, sizeof(buf));
+	if (php_xattr_target_setxattr(target, name, (const char *) buf, sizeof(buf), options) == -1) {
+		return FAILURE;
+	}
+	php_xattr_cache_forget(target->path, target->fd, target->flags, name TSRMLS_CC);
+	return SUCCESS;
+}
+/* }}} */
+
+/* {{{ php_xattr_get_number
+ */
+static void php_xattr_get_number(INTERNAL_FUNCTION_PARAMETERS, int is_double)
+{
+	char *path = NULL, *attr_name = NULL;
+	unsigned char buf[XATTR_NUMBER_SIZE];
+	xattr_strlen_t tmp;
+	xattr_long_t flags = 0;
+	php_xattr_target target;
+	uint64_t bits;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "ss|l", &path, &tmp, &attr_name, &tmp, &flags) == FAILURE) {
+		return;
+	}
+	XATTR_QUIET_FLAG(flags);
+
+	if (php_xattr_check_basedir(path TSRMLS_CC)) {
+		RETURN_FALSE;
+	}
+	php_xattr_queue_sync(path TSRMLS_CC);
+
+	/* Ensure that only allowed bits are set */
+	flags &= ATTR_ROOT | XATTR_XATTR_NOFOLLOW;
+
+	php_xattr_target_path(&target, path, flags);
+	if (php_xattr_read_number(&target, attr_name, buf TSRMLS_CC) == FAILURE) {
+		RETURN_FALSE;
+	}
+
+	bits = php_xattr_le_get(buf, sizeof(buf));
+	if (is_double) {
+		RETURN_DOUBLE(php_xattr_le_double(bits));
+	}
+	RETURN_LONG((xattr_long_t) (int64_t) bits);
+}
+/* }}} */
+
+/* {{{ php_xattr_set_number
+ */
+static void php_xattr_set_number(INTERNAL_FUNCTION_PARAMETERS, int is_double)
+{
+	char *path = NULL, *attr_name = NULL;
+	xattr_strlen_t tmp;
+	xattr_long_t flags = 0, lval = 0;
+	double dval = 0;
+	php_xattr_target target;
+	int rv;
+
+	if (is_double) {
+		rv = zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "ssd|l", &path, &tmp, &attr_name, &tmp, &dval, &flags);
+	} else {
+		rv = zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "ssl|l", &path, &tmp, &attr_name, &tmp, &lval, &flags);
+	}
+	if (rv == FAILURE) {
+		return;
+	}
+	XATTR_QUIET_FLAG(flags);
+
+	if (php_xattr_check_basedir(path TSRMLS_CC)) {
+		RETURN_FALSE;
+	}
+	php_xattr_queue_sync(path TSRMLS_CC);
+
+	/* Ensure that only allowed bits are set */
+	flags &= ATTR_ROOT | XATTR_XATTR_NOFOLLOW | XATTR_XATTR_CREATE | XATTR_XATTR_REPLACE;
+
+	php_xattr_target_path(&target, path, flags & (ATTR_ROOT | XATTR_XATTR_NOFOLLOW));
+	if (php_xattr_write_number(&target, attr_name,
+		is_double ? php_xattr_double_bits(dval) : (uint64_t) (int64_t) lval,
+		(int) (flags & (XATTR_XATTR_CREATE | XATTR_XATTR_REPLACE)) TSRMLS_CC) == FAILURE) {
+		php_xattr_warn(errno, path TSRMLS_CC);
+		RETURN_FALSE;
+	}
+	RETURN_TRUE;
+}
+/* }}} */
+
+/* {{{ proto int xattr_get_int(string path, string name [, int flags])
+   Returns an integer stored by xattr_set_int() */
+PHP_FUNCTION(xattr_get_int)
+{
+	XATTR_FUNCTION_ENTER();
+	php_xattr_get_number(INTERNAL_FUNCTION_PARAM_PASSTHRU, 0);
+}
+/* }}} */
+
+/* {{{ proto bool xattr_set_int(string path, string name, int value [, int flags])
+   Store an integer as 8 bytes little endian */
+PHP_FUNCTION(xattr_set_int)
+{
+	XATTR_FUNCTION_ENTER();
+	php_xattr_set_number(INTERNAL_FUNCTION_PARAM_PASSTHRU, 0);
+}
+/* }}} */
+
+/* {{{ proto float xattr_get_float(string path, string name [, int flags])
+   Returns a float stored by xattr_set_float() */
+PHP_FUNCTION(xattr_get_float)
+{
+	XATTR_FUNCTION_ENTER();
+	php_xattr_get_number(INTERNAL_FUNCTION_PARAM_PASSTHRU, 1);
+}
+/* }}} */
+
+/* {{{ proto bool xattr_set_float(string path, string name, float value [, int flags])
+   Store a float as an 8 bytes little endian double */
+PHP_FUNCTION(xattr_set_float)
+{
+	XATTR_FUNCTION_ENTER();
+	php_xattr_set_number(INTERNAL_FUNCTION_PARAM_PASSTHRU, 1);
+}
+/* }}} */
+
+/* {{{ php_xattr_target_lock
+ * Take an exclusive flock() on the file for a read-modify-write cycle.
+ * That serializes xattr_incr() and xattr_cas() against each other and
+ * against userland flock() on the same file. Returns -1 with errno set if
+ * the lock can't be taken.
+ *
+ * It needs an open file, so when target_open() couldn't open one (no read
+ * permission, XATTR_NOFOLLOW on a symbolic link) the update goes unlocked.
+ * Its writes still use CREATE or REPLACE and are retried up to
+ * XATTR_UPDATE_RETRIES times when another writer got in between, so they
+ * never silently undo a concurrent creation or removal; updates of the
+ * same value may still get lost then.
+ */
+static int php_xattr_target_lock(php_xattr_target *target)
+{
+	int rv = 0;
+
+	if (target->fd != -1) {
+		while ((rv = flock(target->fd, LOCK_EX)) == -1 && errno == EINTR);
+	}
+	return rv;
+}
+
+static void php_xattr_target_unlock(php_xattr_target *target)
+{
+	if (target->fd != -1) {
+		flock(target->fd, LOCK_UN);
+	}
+}
+/* }}} */
+
+/* A writer which doesn't lock may still create or remove the attribute
+ * between reading and writing it, so give up after this many attempts */
+#define XATTR_UPDATE_RETRIES	8
+
+/* {{{ proto int xattr_incr(string path, string name [, int by [, int flags]])
+   Atomically add to an integer attribute, a missing one counts as 0, returns the new value */
+PHP_FUNCTION(xattr_incr)
+{
+	char *path = NULL, *attr_name = NULL;
+	unsigned char buf[XATTR_NUMBER_SIZE];
+	xattr_strlen_t tmp;
+	xattr_long_t flags = 0, by = 1;
+	php_xattr_target target;
+	ssize_t len;
+	int64_t value = 0;
+	int attempt, options, result = FAILURE;
+
+	XATTR_FUNCTION_ENTER();
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "ss|ll", &path, &tmp, &attr_name, &tmp, &by, &flags) == FAILURE) {
+		return;
+	}
+	XATTR_QUIET_FLAG(flags);
+
+	if (php_xattr_check_basedir(path TSRMLS_CC)) {
+		RETURN_FALSE;
+	}
+	php_xattr_queue_sync(path TSRMLS_CC);
+
+	/* Ensure that only allowed bits are set */
+	flags &= ATTR_ROOT | XATTR_XATTR_NOFOLLOW;
+
+	if (php_xattr_target_open(&target, path, flags) == -1) {
+		php_xattr_warn(errno, path TSRMLS_CC);
+		RETURN_FALSE;
+	}
+
+	if (php_xattr_target_lock(&target) == -1) {
+		php_xattr_warn(errno, path TSRMLS_CC);
+		php_xattr_target_close(&target);
+		RETURN_FALSE;
+	}
+	for (attempt = 1; ; attempt++) {
+		len = php_xattr_target_getxattr(&target, attr_name, buf, sizeof(buf));
+		if (len == -1 && errno == XATTR_ENOATTR) {
+			value = 0;
+			options = XATTR_XATTR_CREATE;
+		} else if (len == XATTR_NUMBER_SIZE) {
+			value = (int64_t) php_xattr_le_get(buf, sizeof(buf));
+			options = XATTR_XATTR_REPLACE;
+		} else {
+			/* Reading again warns about whatever is wrong */
+			php_xattr_read_number(&target, attr_name, buf TSRMLS_CC);
+			break;
+		}
+
+		/* Wraps around like the unsigned arithmetic it is done with */
+		value = (int64_t) ((uint64_t) value + (uint64_t) (int64_t) by);
+		if (php_xattr_write_number(&target, attr_name, (uint64_t) value, options TSRMLS_CC) == SUCCESS) {
+			result = SUCCESS;
+			break;
+		}
+		if ((errno != EEXIST && errno != XATTR_ENOATTR) || attempt == XATTR_UPDATE_RETRIES) {
+			php_xattr_warn(errno, path TSRMLS_CC);
+			break;
+		}
+	}
+	php_xattr_target_unlock(&target);
+	php_xattr_target_close(&target);
+
+	if (result == FAILURE) {
+		RETURN_FALSE;
+	}
+	RETURN_LONG((xattr_long_t) value);
+}
+/* }}} */
+
+/* {{{ proto bool xattr_cas(string path, string name, string expected, string value [, int flags])
+   Atomically replace an attribute if it still has the expected value, null expects it to be missing */
+PHP_FUNCTION(xattr_cas)
+{
+	char *path = NULL, *attr_name = NULL, *expected = NULL, *attr_value = NULL, *packed;
+	xattr_string *current;
+	xattr_strlen_t tmp, expected_len = 0, value_len;
+	xattr_long_t flags = 0;
+	php_xattr_target target;
+	ssize_t current_len;
+	size_t packed_len;
+	int options, result = FAILURE;
+
+	XATTR_FUNCTION_ENTER();
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "sss!s|l", &path, &tmp, &attr_name, &tmp, &expected, &expected_len, &attr_value, &value_len, &flags) == FAILURE) {
+		return;
+	}
+	XATTR_QUIET_FLAG(flags);
+
+	if (php_xattr_check_basedir(path TSRMLS_CC)) {
+		RETURN_FALSE;
+	}
+	php_xattr_queue_sync(path TSRMLS_CC);
+
+	/* Ensure that only allowed bits are set */
+	flags &= ATTR_ROOT | XATTR_XATTR_NOFOLLOW;
+
+	if (php_xattr_target_open(&target, path, flags) == -1) {
+		php_xattr_warn(errno, path TSRMLS_CC);
+		RETURN_FALSE;
+	}
+
+	packed = php_xattr_deflate(attr_value, value_len, &packed_len TSRMLS_CC);
+	if (packed) {
+		attr_value = packed;
+		value_len = (xattr_strlen_t) packed_len;
+	}
+
+	if (php_xattr_target_lock(&target) == -1) {
+		php_xattr_warn(errno, path TSRMLS_CC);
+		php_xattr_target_close(&target);
+		if (packed) {
+			efree(packed);
+		}
+		RETURN_FALSE;
+	}
+	current_len = php_xattr_target_read(&target, attr_name, &current);
+	if (current_len >= 0) {
+		if (php_xattr_decode(&target, attr_name, &current, &current_len TSRMLS_CC) == SUCCESS) {
+			if (expected && (size_t) current_len == (size_t) expected_len
+				&& !memcmp(xattr_string_val(current), expected, expected_len)) {
+				result = SUCCESS;
+			}
+			xattr_string_free(current);
+		}
+		options = XATTR_XATTR_REPLACE;
+	} else if (errno == XATTR_ENOATTR) {
+		result = expected ? FAILURE : SUCCESS;
+		options = XATTR_XATTR_CREATE;
+	} else {
+		php_xattr_warn(errno, path TSRMLS_CC);
+	}
+
+	/* A writer which doesn't lock changing things in between is a mismatch too */
+	if (result == SUCCESS) {
+		if (php_xattr_target_store(&target, attr_name, attr_value, value_len, options TSRMLS_CC) == -1) {
+			if (errno != EEXIST && errno != XATTR_ENOATTR) {
+				php_xattr_warn(errno, path TSRMLS_CC);
+			}
+			result = FAILURE;
+		} else {
+			php_xattr_cache_forget(path, target.fd, flags, attr_name TSRMLS_CC);
+		}
+	}
+	php_xattr_target_unlock(&target);
+	php_xattr_target_close(&target);
+
+	if (packed) {
+		efree(packed);
+	}
+	RETURN_BOOL(result == SUCCESS);
+}
+/* }}} */
+
+/* {{{ proto array xattr_get_packed(string path, string name, string format [, int flags])
+   Decode fields of a binary attribute, format is like "Vcount/Ptime/eaverage" */
+PHP_FUNCTION(xattr_get_packed)
+{
+	char *path = NULL, *attr_name = NULL, *format = NULL, *key;
+	const char *p, *end, *field_end;
+	const unsigned char *data;
+	xattr_string *value;
+	xattr_strlen_t tmp, format_len;
+	xattr_long_t flags = 0;
+	php_xattr_target target;
+	ssize_t value_len;
+	size_t off = 0, width;
+	uint64_t bits;
+
+	XATTR_FUNCTION_ENTER();
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "sss|l", &path, &tmp, &attr_name, &tmp, &format, &format_len, &flags) == FAILURE) {
+		return;
+	}
+	XATTR_QUIET_FLAG(flags);
+
+	if (php_xattr_check_basedir(path TSRMLS_CC)) {
+		RETURN_FALSE;
+	}
+	php_xattr_queue_sync(path TSRMLS_CC);
+
+	/* Ensure that only allowed bits are set */
+	flags &= ATTR_ROOT | XATTR_XATTR_NOFOLLOW;
+
+	php_xattr_target_path(&target, path, flags);
+	value_len = php_xattr_target_read(&target, attr_name, &value);
+	if (value_len < 0) {
+		php_xattr_warn(errno, path TSRMLS_CC);
+		RETURN_FALSE;
+	}
+	if (php_xattr_decode(&target, attr_name, &value, &value_len TSRMLS_CC) == FAILURE) {
+		RETURN_FALSE;
+	}
+	data = (const unsigned char *) xattr_string_val(value);
+
+	array_init(return_value);
+	for (p = format, end = format + format_len; p < end; p = field_end < end ? field_end + 1 : end) {
+		field_end = memchr(p, '/', end - p);
+		if (!field_end) {
+			field_end = end;
+		}
+		/* "V//C" or a trailing slash: nothing between the slashes */
+		if (field_end == p) {
+			continue;
+		}
+
+		switch (*p) {
+			case 'c': case 'C': case 'x':
+				width = 1;
+				break;
+			case 'v':
+				width = 2;
+				break;
+			case 'V': case 'g':
+				width = 4;
+				break;
+			case 'P': case 'e':
+				width = 8;
+				break;
+			default:
+				if (php_xattr_error(EINVAL TSRMLS_CC)) {
+					php_error(E_WARNING, "%s Unknown format code '%c'", get_active_function_name(TSRMLS_C), *p);
+				}
+				goto fail;
+		}
+		if (width > (size_t) value_len - off) {
+			if (php_xattr_error(EINVAL TSRMLS_CC)) {
+				php_error(E_WARNING, "%s Attribute %s is too short for the format", get_active_function_name(TSRMLS_C), attr_name);
+			}
+			goto fail;
+		}
+
+		bits = php_xattr_le_get(data + off, width);
+		off += width;
+		if (*p == 'x') {
+			continue;
+		}
+
+		key = estrndup(p + 1, field_end - p - 1);
+		switch (*p) {
+			case 'c':
+				add_assoc_long_ex(return_value, key, XATTR_ASSOC_KEYLEN(field_end - p - 1), (xattr_long_t) (signed char) bits);
+				break;
+			case 'g': {
+				uint32_t bits32 = (uint32_t) bits;
+				float f;
+
+				memcpy(&f, &bits32, sizeof(f));
+				add_assoc_double_ex(return_value, key, XATTR_ASSOC_KEYLEN(field_end - p - 1), (double) f);
+				break;
+			}
+			case 'e':
+				add_assoc_double_ex(return_value, key, XATTR_ASSOC_KEYLEN(field_end - p - 1), php_xattr_le_double(bits));
+				break;
+			case 'P':
+				add_assoc_long_ex(return_value, key, XATTR_ASSOC_KEYLEN(field_end - p - 1), (xattr_long_t) (int64_t) bits);
+				break;
+			default:
+				add_assoc_long_ex(return_value, key, XATTR_ASSOC_KEYLEN(field_end - p - 1), (xattr_long_t) bits);
+		}
+		efree(key);
+	}
+
+	xattr_string_free(value);
+	return;
+
+fail:
+	xattr_string_free(value);
+	zval_dtor(return_value);
+	RETURN_FALSE;
+}
+/* }}} */
+
+/* {{{ proto bool xattr_fset(resource stream, string name, string value [, int flags])
+   Set an extended attribute of an open file */
+PHP_FUNCTION(xattr_fset)
+{
+	char *attr_name = NULL;
+	char *attr_value = NULL;
+	char *packed;
+	zval *zstream;
+	int fd, error;
+	xattr_strlen_t tmp, value_len;
+	xattr_long_t flags = 0;
+	php_xattr_target target;
+	size_t packed_len;
+
+	XATTR_FUNCTION_ENTER();
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "rss|l", &zstream, &attr_name, &tmp, &attr_value, &value_len, &flags) == FAILURE) {
+		return;
+	}
+	XATTR_QUIET_FLAG(flags);
+
+	if (php_xattr_stream_fd(zstream, &fd TSRMLS_CC) == FAILURE) {
+		RETURN_FALSE;
+	}
+	php_xattr_queue_sync(NULL TSRMLS_CC);
+
+	/* Ensure that only allowed bits are set */
+	flags &= XATTR_XATTR_CREATE | XATTR_XATTR_REPLACE;
+
+	packed = php_xattr_deflate(attr_value, value_len, &packed_len TSRMLS_CC);
+	php_xattr_target_fd(&target, fd);
+	error = php_xattr_target_store(&target, attr_name, packed ? packed : attr_value, packed ? packed_len : (size_t) value_len, (int) flags TSRMLS_CC);
+	if (packed) {
+		efree(packed);
+	}
+	if (error == -1) {
+		php_xattr_warn(errno, NULL TSRMLS_CC);
+		RETURN_FALSE;
+	}
+
+	php_xattr_cache_forget(NULL, fd, 0, attr_name TSRMLS_CC);
+	RETURN_TRUE;
+}
+/* }}} */
+
+/* {{{ proto string xattr_fget(resource stream, string name)
+   Returns a value of an extended attribute of an open file */
+PHP_FUNCTION(xattr_fget)
+{
+	char *attr_name = NULL;
+	zval *zstream;
+	xattr_string *attr_value;
+	xattr_strlen_t tmp;
+	php_xattr_target target;
+	ssize_t value_len;
+	int fd;
+
+	XATTR_FUNCTION_ENTER();
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "rs", &zstream, &attr_name, &tmp) == FAILURE) {
+		return;
+	}
+
+	if (php_xattr_stream_fd(zstream, &fd TSRMLS_CC) == FAILURE) {
+		RETURN_FALSE;
+	}
+	php_xattr_queue_sync(NULL TSRMLS_CC);
+
+	php_xattr_target_fd(&target, fd);
+	value_len = php_xattr_target_read(&target, attr_name, &attr_value);
+	if (value_len >= 0) {
+		if (php_xattr_decode(&target, attr_name, &attr_value, &value_len TSRMLS_CC) == FAILURE) {
+			RETURN_FALSE;
+		}
+		xattr_zval_string(return_value, attr_value, value_len);
+		return;
+	}
+
+	php_xattr_warn(errno, NULL TSRMLS_CC);
+	RETURN_FALSE;
+}
+/* }}} */
+
+/* {{{ proto bool xattr_fremove(resource stream, string name)
+   Remove an extended attribute of an open file */
+PHP_FUNCTION(xattr_fremove)
+{
+	char *attr_name = NULL;
+	zval *zstream;
+	xattr_strlen_t tmp;
+	php_xattr_target target;
+	int fd;
+
+	XATTR_FUNCTION_ENTER();
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "rs", &zstream, &attr_name, &tmp) == FAILURE) {
+		return;
+	}
+
+	if (php_xattr_stream_fd(zstream, &fd TSRMLS_CC) == FAILURE) {
+		RETURN_FALSE;
+	}
+	php_xattr_queue_sync(NULL TSRMLS_CC);
+
+	php_xattr_target_fd(&target, fd);
+	if (php_xattr_target_remove(&target, attr_name TSRMLS_CC) == -1) {
+		php_xattr_warn(errno, NULL TSRMLS_CC);
+		RETURN_FALSE;
+	}
+
+	php_xattr_cache_forget(NULL, fd, 0, attr_name TSRMLS_CC);
+	RETURN_TRUE;
+}
+/* }}} */
+
+/* {{{ proto array xattr_flist(resource stream)
+   Get list of extended attributes of an open file */
+PHP_FUNCTION(xattr_flist)
+{
+	char buffer[XATTR_BUFFER_SIZE], *namebuf;
+	zval *zstream;
+	php_xattr_target target;
+	ssize_t list_len;
+	int fd;
+
+	XATTR_FUNCTION_ENTER();
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "r", &zstream) == FAILURE) {
+		return;
+	}
+
+	if (php_xattr_stream_fd(zstream, &fd TSRMLS_CC) == FAILURE) {
+		RETURN_FALSE;
+	}
+	php_xattr_queue_sync(NULL TSRMLS_CC);
+
+	php_xattr_target_fd(&target, fd);
+	list_len = php_xattr_target_list(&target, buffer, &namebuf);
+	if (list_len < 0) {
+		php_xattr_warn(errno, NULL TSRMLS_CC);
+		RETURN_FALSE;
+	}
+
+	php_xattr_list_to_array(return_value, &target, namebuf, list_len TSRMLS_CC);
+	php_xattr_target_list_free(buffer, namebuf);
+}
+/* }}} */
+
+/* {{{ proto bool xattr_set_at(resource dir, string file, string name, string value [, int flags])
+   Set an extended attribute of a file inside an open directory */
+PHP_FUNCTION(xattr_set_at)
+{
+	char *file = NULL;
+	char *attr_name = NULL;
+	char *attr_value = NULL;
+	char *packed;
+	zval *zdir;
+	int dirfd, error;
+	xattr_strlen_t tmp, value_len;
+	xattr_long_t flags = 0;
+	php_xattr_target target;
+	size_t packed_len;
+
+	XATTR_FUNCTION_ENTER();
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "rsss|l", &zdir, &file, &tmp, &attr_name, &tmp, &attr_value, &value_len, &flags) == FAILURE) {
+		return;
+	}
+	XATTR_QUIET_FLAG(flags);
+
+	/* Ensure that only allowed bits are set */
+	flags &= XATTR_XATTR_NOFOLLOW | XATTR_XATTR_CREATE | XATTR_XATTR_REPLACE;
+
+	if (php_xattr_stream_fd(zdir, &dirfd TSRMLS_CC) == FAILURE
+		|| php_xattr_check_component(dirfd, file, flags TSRMLS_CC) == FAILURE) {
+		RETURN_FALSE;
+	}
+	php_xattr_queue_sync(NULL TSRMLS_CC);
+
+	packed = php_xattr_deflate(attr_value, value_len, &packed_len TSRMLS_CC);
+	php_xattr_target_at(&target, dirfd, file, flags & XATTR_XATTR_NOFOLLOW);
+	error = php_xattr_target_store(&target, attr_name, packed ? packed : attr_value, packed ? packed_len : (size_t) value_len, (int) (flags & (XATTR_XATTR_CREATE | XATTR_XATTR_REPLACE)) TSRMLS_CC);
+	if (packed) {
+		efree(packed);
+	}
+	if (error == -1) {
+		php_xattr_warn(errno, file TSRMLS_CC);
+		RETURN_FALSE;
+	}
+	php_xattr_cache_forget_at(dirfd, file, (int) flags, attr_name TSRMLS_CC);
+
+	RETURN_TRUE;
+}
+/* }}} */
+
+/* {{{ proto string xattr_get_at(resource dir, string file, string name [, int flags])
+   Returns a value of an extended attribute of a file inside an open directory */
+PHP_FUNCTION(xattr_get_at)
+{
+	char *file = NULL;
+	char *attr_name = NULL;
+	zval *zdir;
+	xattr_string *attr_value;
+	xattr_strlen_t tmp;
+	xattr_long_t flags = 0;
+	php_xattr_target target;
+	ssize_t value_len;
+	int dirfd;
+
+	XATTR_FUNCTION_ENTER();
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "rss|l", &zdir, &file, &tmp, &attr_name, &tmp, &flags) == FAILURE) {
+		return;
+	}
+	XATTR_QUIET_FLAG(flags);
+
+	/* Ensure that only allowed bits are set */
+	flags &= XATTR_XATTR_NOFOLLOW;
+
+	if (php_xattr_stream_fd(zdir, &dirfd TSRMLS_CC) == FAILURE
+		|| php_xattr_check_component(dirfd, file, flags TSRMLS_CC) == FAILURE) {
+		RETURN_FALSE;
+	}
+	php_xattr_queue_sync(NULL TSRMLS_CC);
+
+	php_xattr_target_at(&target, dirfd, file, flags);
+	value_len = php_xattr_target_read(&target, attr_name, &attr_value);
+	if (value_len >= 0) {
+		if (php_xattr_decode(&target, attr_name, &attr_value, &value_len TSRMLS_CC) == FAILURE) {
+			RETURN_FALSE;
+		}
+		xattr_zval_string(return_value, attr_value, value_len);
+		return;
+	}
+
+	php_xattr_warn(errno, file TSRMLS_CC);
+	RETURN_FALSE;
+}
+/* }}} */
+
+/* {{{ proto bool xattr_remove_at(resource dir, string file, string name [, int flags])
+   Remove an extended attribute of a file inside an open directory */
+PHP_FUNCTION(xattr_remove_at)
+{
+	char *file = NULL;
+	char *attr_name = NULL;
+	zval *zdir;
+	int dirfd;
+	xattr_strlen_t tmp;
+	xattr_long_t flags = 0;
+	php_xattr_target target;
+
+	XATTR_FUNCTION_ENTER();
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "rss|l", &zdir, &file, &tmp, &attr_name, &tmp, &flags) == FAILURE) {
+		return;
+	}
+	XATTR_QUIET_FLAG(flags);
+
+	/* Ensure that only allowed bits are set */
+	flags &= XATTR_XATTR_NOFOLLOW;
+
+	if (php_xattr_stream_fd(zdir, &dirfd TSRMLS_CC) == FAILURE
+		|| php_xattr_check_component(dirfd, file, flags TSRMLS_CC) == FAILURE) {
+		RETURN_FALSE;
+	}
+	php_xattr_queue_sync(NULL TSRMLS_CC);
+
+	php_xattr_target_at(&target, dirfd, file, flags);
+	if (php_xattr_target_remove(&target, attr_name TSRMLS_CC) == -1) {
+		php_xattr_warn(errno, file TSRMLS_CC);
+		RETURN_FALSE;
+	}
+	php_xattr_cache_forget_at(dirfd, file, (int) flags, attr_name TSRMLS_CC);
+
+	RETURN_TRUE;
+}
+/* }}} */
+
+/* {{{ proto array xattr_list_at(resource dir, string file [, int flags])
+   Get list of extended attributes of a file inside an open directory */
+PHP_FUNCTION(xattr_list_at)
+{
+	char buffer[XATTR_BUFFER_SIZE], *namebuf;
+	char *file = NULL;
+	zval *zdir;
+	xattr_strlen_t tmp;
+	xattr_long_t flags = 0;
+	php_xattr_target target;
+	ssize_t list_len;
+	int dirfd;
+
+	XATTR_FUNCTION_ENTER();
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "rs|l", &zdir, &file, &tmp, &flags) == FAILURE) {
+		return;
+	}
+	XATTR_QUIET_FLAG(flags);
+
+	/* Ensure that only allowed bits are set */
+	flags &= XATTR_XATTR_NOFOLLOW;
+
+	if (php_xattr_stream_fd(zdir, &dirfd TSRMLS_CC) == FAILURE
+		|| php_xattr_check_component(dirfd, file, flags TSRMLS_CC) == FAILURE) {
+		RETURN_FALSE;
+	}
+	php_xattr_queue_sync(NULL TSRMLS_CC);
+
+	php_xattr_target_at(&target, dirfd, file, flags);
+	list_len = php_xattr_target_list(&target, buffer, &namebuf);
+	if (list_len < 0) {
+		php_xattr_warn(errno, file TSRMLS_CC);
+		RETURN_FALSE;
+	}
+
+	php_xattr_list_to_array(return_value, &target, namebuf, list_len TSRMLS_CC);
+	php_xattr_target_list_free(buffer, namebuf);
+}
+/* }}} */
+
+/* {{{ proto array xattr_get_paths(array paths, mixed names [, int flags])
+   Returns the value of an extended attribute, or an array of values of several ones, for every path.
+   Unreadable files and missing attributes are reported as false, not as warnings */
+PHP_FUNCTION(xattr_get_paths)
+{
+	zval *paths, *names, *entry;
+	xattr_tmp_string *path_strs, *name_strs;
+	const char **attr_names;
+	xattr_string **values;
+	xattr_long_t flags = 0;
+	xattr_batch_op *ops;
+	xattr_uring *ring = NULL;
+	php_xattr_target target;
+	ssize_t *lens;
+	size_t i, j, k, np, nn, nops;
+	char *ok;
+	int single;
+
+	XATTR_FUNCTION_ENTER();
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "az|l", &paths, &names, &flags) == FAILURE) {
+		return;
+	}
+	XATTR_QUIET_FLAG(flags);
+
+	/* Ensure that only allowed bits are set */
+	flags &= ATTR_ROOT | XATTR_XATTR_NOFOLLOW;
+
+	single = Z_TYPE_P(names) != IS_ARRAY;
+	nn = single ? 1 : zend_hash_num_elements(Z_ARRVAL_P(names));
+	np = zend_hash_num_elements(Z_ARRVAL_P(paths));
+
+	name_strs = safe_emalloc(nn, sizeof(*name_strs), 0);
+	attr_names = safe_emalloc(nn, sizeof(*attr_names), 0);
+	if (single) {
+		xattr_tmp_string_init(&name_strs[0], names);
+		attr_names[0] = xattr_tmp_string_val(&name_strs[0]);
+	} else {
+		i = 0;
+		XATTR_HASH_FOREACH_VAL(Z_ARRVAL_P(names), entry) {
+			xattr_tmp_string_init(&name_strs[i], entry);
+			attr_names[i] = xattr_tmp_string_val(&name_strs[i]);
+			i++;
+		} XATTR_HASH_FOREACH_END();
+	}
+
+	path_strs = safe_emalloc(np, sizeof(*path_strs), 0);
+	ok = emalloc(np + 1);
+	i = 0;
+	XATTR_HASH_FOREACH_VAL(Z_ARRVAL_P(paths), entry) {
+		xattr_tmp_string_init(&path_strs[i], entry);
+		ok[i] = !php_xattr_check_basedir_quiet(xattr_tmp_string_val(&path_strs[i]) TSRMLS_CC);
+		if (ok[i]) {
+			php_xattr_queue_sync(xattr_tmp_string_val(&path_strs[i]) TSRMLS_CC);
+		}
+		i++;
+	} XATTR_HASH_FOREACH_END();
+
+	values = safe_emalloc(np, nn * sizeof(*values), 0);
+	lens = safe_emalloc(np, nn * sizeof(*lens), 0);
+
+	if (np * nn >= XATTR_URING_MIN_BATCH) {
+		ring = php_xattr_uring(TSRMLS_C);
+	}
+
+	if (ring) {
+		/* Every value of every file in one batch, by path */
+		ops = safe_emalloc(np, nn * sizeof(*ops), 0);
+		for (i = 0, nops = 0; i < np; i++) {
+			if (!ok[i]) {
+				continue;
+			}
+			php_xattr_target_path(&target, xattr_tmp_string_val(&path_strs[i]), flags);
+			for (j = 0; j < nn; j++) {
+				php_xattr_batch_prepare(&ops[nops++], &target, attr_names[j], &values[i * nn + j]);
+			}
+		}
+
+		xattr_batch_run(ring, ops, nops);
+
+		for (i = 0, nops = 0; i < np; i++) {
+			if (!ok[i]) {
+				for (j = 0; j < nn; j++) {
+					lens[i * nn + j] = -1;
+				}
+				continue;
+			}
+			php_xattr_target_path(&target, xattr_tmp_string_val(&path_strs[i]), flags);
+			for (j = 0, k = i * nn; j < nn; j++, k++) {
+				lens[k] = php_xattr_batch_result(&ops[nops++], &target, &values[k]);
+				if (lens[k] < 0 && (errno == ENOENT || errno == ENOTDIR)) {
+					ok[i] = 0;
+				}
+			}
+		}
+		efree(ops);
+	} else {
+		for (i = 0; i < np; i++) {
+			if (ok[i]) {
+				/* Opening the file only pays off for several names */
+				if (nn > 1) {
+					ok[i] = php_xattr_target_open(&target, xattr_tmp_string_val(&path_strs[i]), flags) == 0;
+				} else {
+					php_xattr_target_path(&target, xattr_tmp_string_val(&path_strs[i]), flags);
+				}
+			}
+			if (!ok[i]) {
+				for (j = 0; j < nn; j++) {
+					lens[i * nn + j] = -1;
+				}
+				continue;
+			}
+
+			php_xattr_target_read_batch(&target, attr_names, nn, values + i * nn, lens + i * nn TSRMLS_CC);
+			php_xattr_target_close(&target);
+			if (single && lens[i] < 0 && (errno == ENOENT || errno == ENOTDIR)) {
+				ok[i] = 0;
 			}
 		}
-		efree(buffer);
 	}
-	else if (errno) { /* Print warning on common errors */
-		switch (errno) {
-			case ENOTSUP:
-				php_error(E_WARNING, "%s Operation not supported", get_active_function_name(TSRMLS_C));
-				break;
-			case ENOENT:
-			case ENOTDIR:
-				php_error(E_WARNING, "%s File %s doesn't exists", get_active_function_name(TSRMLS_C), path);
-				break;
-			case EACCES:
-				php_error(E_WARNING, "%s Permission denied", get_active_function_name(TSRMLS_C));
+
+	array_init(return_value);
+	for (i = 0; i < np; i++) {
+		const char *path = xattr_tmp_string_val(&path_strs[i]);
+		size_t path_len = xattr_tmp_string_len(&path_strs[i]);
+
+		php_xattr_target_path(&target, path, flags);
+		if (single) {
+			if (lens[i] >= 0 && php_xattr_decode(&target, attr_names[0], &values[i], &lens[i] TSRMLS_CC) == SUCCESS) {
+				xattr_add_assoc_string(return_value, path, path_len, values[i], lens[i]);
+			} else {
+				add_assoc_bool_ex(return_value, path, XATTR_ASSOC_KEYLEN(path_len), 0);
+			}
+		} else if (!ok[i]) {
+			for (j = 0, k = i * nn; j < nn; j++, k++) {
+				if (lens[k] >= 0) {
+					xattr_string_free(values[k]);
+				}
+			}
+			add_assoc_bool_ex(return_value, path, XATTR_ASSOC_KEYLEN(path_len), 0);
+		} else {
+			XATTR_ZVAL_DECLARE(attrs);
+
+			xattr_zval_array_init(attrs);
+			for (j = 0, k = i * nn; j < nn; j++, k++) {
+				if (lens[k] >= 0 && php_xattr_decode(&target, attr_names[j], &values[k], &lens[k] TSRMLS_CC) == SUCCESS) {
+					xattr_add_assoc_string(attrs, attr_names[j], xattr_tmp_string_len(&name_strs[j]), values[k], lens[k]);
+				} else {
+					add_assoc_bool_ex(attrs, attr_names[j], XATTR_ASSOC_KEYLEN(xattr_tmp_string_len(&name_strs[j])), 0);
+				}
+			}
+			add_assoc_zval_ex(return_value, path, XATTR_ASSOC_KEYLEN(path_len), attrs);
+		}
+		xattr_tmp_string_free(&path_strs[i]);
+	}
+
+	for (j = 0; j < nn; j++) {
+		xattr_tmp_string_free(&name_strs[j]);
+	}
+	efree(lens);
+	efree(values);
+	efree(ok);
+	efree(path_strs);
+	efree(attr_names);
+	efree(name_strs);
+}
+/* }}} */
+
+/* {{{ proto resource xattr_scan(string root [, array options])
+   Start walking the tree below root, options are "prefix", "depth", "skip_empty" and "threads" */
+PHP_FUNCTION(xattr_scan)
+{
+	char *root = NULL;
+	zval *options = NULL, *option;
+	xattr_tmp_string prefix;
+	xattr_strlen_t root_len;
+	xattr_scan_options opts;
+	xattr_scan *scan;
+	int has_prefix = 0;
+
+	XATTR_FUNCTION_ENTER();
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "s|a", &root, &root_len, &options) == FAILURE) {
+		return;
+	}
+
+	/* Only the root is checked, the walk never follows symbolic links out of it */
+	if (php_xattr_check_basedir(root TSRMLS_CC)) {
+		RETURN_FALSE;
+	}
+	php_xattr_queue_sync(NULL TSRMLS_CC);
+
+	opts.prefix = NULL;
+	opts.max_depth = -1;
+	opts.skip_empty = 0;
+	opts.threads = 0;
+
+	if (options) {
+		if ((option = xattr_hash_str_find(Z_ARRVAL_P(options), "prefix", sizeof("prefix") - 1)) != NULL) {
+			xattr_tmp_string_init(&prefix, option);
+			opts.prefix = xattr_tmp_string_val(&prefix);
+			has_prefix = 1;
+		}
+		if ((option = xattr_hash_str_find(Z_ARRVAL_P(options), "depth", sizeof("depth") - 1)) != NULL) {
+			opts.max_depth = (int) xattr_zval_get_long(option);
+		}
+		if ((option = xattr_hash_str_find(Z_ARRVAL_P(options), "skip_empty", sizeof("skip_empty") - 1)) != NULL) {
+			opts.skip_empty = zend_is_true(option);
+		}
+		if ((option = xattr_hash_str_find(Z_ARRVAL_P(options), "threads", sizeof("threads") - 1)) != NULL) {
+			opts.threads = (int) xattr_zval_get_long(option);
+		}
+	}
+
+	scan = xattr_scan_open(root, &opts);
+	if (has_prefix) {
+		xattr_tmp_string_free(&prefix);
+	}
+	if (!scan) {
+		php_xattr_warn(errno, root TSRMLS_CC);
+		RETURN_FALSE;
+	}
+
+	xattr_register_resource(return_value, scan, le_xattr_scan);
+}
+/* }}} */
+
+/* {{{ php_xattr_scan_assemble
+ * Put a chunked value of a scanned file together from the chunks the entry
+ * holds too, which are marked in skip. Returns NULL if any is missing.
+ */
+static xattr_string *php_xattr_scan_assemble(xattr_scan_entry *entry, size_t manifest, size_t total, size_t chunk_size, size_t count, char *skip)
+{
+	const xattr_scan_attr *attr = &entry->attrs[manifest];
+	xattr_string *out;
+	char *chunk_name;
+	size_t stride = attr->name_len + XATTR_CHUNK_SUFFIX, chunk_len, i, j, want;
+
+	out = xattr_string_alloc(total);
+	chunk_name = emalloc(stride);
+	for (i = 0; i < count; i++) {
+		chunk_len = (size_t) snprintf(chunk_name, stride, "%.*s.%lu", (int) attr->name_len, attr->name, (unsigned long) i);
+		want = i + 1 < count ? chunk_size : total - i * chunk_size;
+		for (j = 0; j < entry->count; j++) {
+			if (entry->attrs[j].name_len == chunk_len && !memcmp(entry->attrs[j].name, chunk_name, chunk_len)) {
 				break;
+			}
+		}
+		if (j == entry->count || entry->attrs[j].value_len != want) {
+			efree(chunk_name);
+			xattr_string_free(out);
+			return NULL;
+		}
+		memcpy(xattr_string_val(out) + i * chunk_size, entry->attrs[j].value, want);
+		skip[j] = 1;
+	}
+	efree(chunk_name);
+	return out;
+}
+/* }}} */
+
+/* {{{ proto array xattr_scan_next(resource scan)
+   Returns array(relative path, attributes) for the next file, false once the walk is over */
+PHP_FUNCTION(xattr_scan_next)
+{
+	zval *zscan;
+	XATTR_ZVAL_DECLARE(attrs);
+	xattr_scan *scan;
+	xattr_scan_entry *entry;
+	xattr_string **values, *orig;
+	size_t *lens, i, total, chunk_size, count, orig_len;
+	char *skip;
+	int rv;
+
+	XATTR_FUNCTION_ENTER();
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "r", &zscan) == FAILURE) {
+		return;
+	}
+
+	scan = (xattr_scan *) xattr_fetch_resource(zscan, PHP_XATTR_SCAN_RES_NAME, le_xattr_scan);
+	if (!scan) {
+		RETURN_FALSE;
+	}
+
+	rv = xattr_scan_next(scan, &entry);
+	if (rv <= 0) {
+		if (rv < 0) {
+			php_xattr_warn(errno, NULL TSRMLS_CC);
 		}
-		
 		RETURN_FALSE;
 	}
-	
+
+	/* Values come as xattr_get() returns them, chunks with the value they belong to */
+	skip = ecalloc(entry->count + 1, 1);
+	values = ecalloc(entry->count + 1, sizeof(*values));
+	lens = ecalloc(entry->count + 1, sizeof(*lens));
+	for (i = 0; i < entry->count; i++) {
+		if (php_xattr_chunk_manifest(entry->attrs[i].value, entry->attrs[i].value_len, &total, &chunk_size, &count) == SUCCESS
+			&& (values[i] = php_xattr_scan_assemble(entry, i, total, chunk_size, count, skip)) != NULL) {
+			lens[i] = total;
+		}
+	}
+
+	xattr_zval_array_init(attrs);
+	for (i = 0; i < entry->count; i++) {
+		if (skip[i]) {
+			if (values[i]) {
+				xattr_string_free(values[i]);
+			}
+			continue;
+		}
+		orig = php_xattr_inflate(values[i] ? xattr_string_val(values[i]) : entry->attrs[i].value,
+			values[i] ? lens[i] : entry->attrs[i].value_len, &orig_len TSRMLS_CC);
+		if (orig) {
+			if (values[i]) {
+				xattr_string_free(values[i]);
+			}
+			values[i] = orig;
+			lens[i] = orig_len;
+		}
+		if (values[i]) {
+			xattr_add_assoc_string(attrs, entry->attrs[i].name, entry->attrs[i].name_len, values[i], lens[i]);
+		} else {
+			xattr_add_assoc_stringl(attrs, entry->attrs[i].name, entry->attrs[i].name_len,
+				entry->attrs[i].value, entry->attrs[i].value_len);
+		}
+	}
+	efree(lens);
+	efree(values);
+	efree(skip);
+
+	array_init(return_value);
+	xattr_add_next_index_stringl(return_value, entry->path, entry->path_len);
+	add_next_index_zval(return_value, attrs);
+
+	xattr_scan_entry_free(entry);
 }
-/* }}} */   
+/* }}} */
+
+/* {{{ proto bool xattr_scan_close(resource scan)
+   Stop a walk started by xattr_scan() and release it */
+PHP_FUNCTION(xattr_scan_close)
+{
+	zval *zscan;
+
+	XATTR_FUNCTION_ENTER();
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "r", &zscan) == FAILURE) {
+		return;
+	}
+
+	if (!xattr_fetch_resource(zscan, PHP_XATTR_SCAN_RES_NAME, le_xattr_scan)) {
+		RETURN_FALSE;
+	}
+
+	xattr_close_resource(zscan);
+	RETURN_TRUE;
+}
+/* }}} */
+
+/* {{{ proto bool xattr_flush([string path])
+   Write attributes held back by xattr.write_behind, for path only if given */
+PHP_FUNCTION(xattr_flush)
+{
+	char *path = NULL;
+	xattr_strlen_t path_len;
+
+	XATTR_FUNCTION_ENTER();
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "|s", &path, &path_len) == FAILURE) {
+		return;
+	}
+
+	RETURN_BOOL(php_xattr_queue_sync(path TSRMLS_CC) == SUCCESS);
+}
+/* }}} */
+
+/* {{{ php_xattr_stats_add
+ * The counters of xattr.stats: "functions" maps function names to calls,
+ * "ops" backend calls to their counts, bytes, total time and latency
+ * histogram, keyed by the upper bound of each bucket in ns, and "errno"
+ * the errno values of failed calls to how often they occurred. Those of
+ * this request only with request set, everything counted so far otherwise.
+ */
+static void php_xattr_stats_add(zval *array, int request TSRMLS_DC)
+{
+	static const xattr_stats none;
+	const xattr_stats *stats = xattr_stats_get(), *base = &none;
+	const xattr_op_stats *op, *op_base;
+	unsigned long calls;
+	int i, j;
+	XATTR_ZVAL_DECLARE(functions);
+	XATTR_ZVAL_DECLARE(ops);
+	XATTR_ZVAL_DECLARE(errnos);
+
+	if (request) {
+		/* Nothing was counted yet if no copy was taken */
+		base = XATTR_G(stats_base_taken) ? XATTR_G(stats_base) : stats;
+	}
+
+	xattr_zval_array_init(functions);
+	for (i = 0; i < XATTR_G(stats_functions); i++) {
+		calls = XATTR_G(stats_calls)[i].calls;
+		if (request) {
+			calls = XATTR_G(stats_base_taken) ? calls - XATTR_G(stats_calls_base)[i] : 0;
+		}
+		if (calls) {
+			add_assoc_long(functions, (char *) XATTR_G(stats_calls)[i].name, (xattr_long_t) calls);
+		}
+	}
+	add_assoc_zval(array, "functions", functions);
+
+	xattr_zval_array_init(ops);
+	for (i = 0; i < XATTR_OP_COUNT; i++) {
+		XATTR_ZVAL_DECLARE(entry);
+		XATTR_ZVAL_DECLARE(latency);
+
+		op = &stats->ops[i];
+		op_base = &base->ops[i];
+		if (op->calls == op_base->calls) {
+			continue;
+		}
+		xattr_zval_array_init(entry);
+		add_assoc_long(entry, "calls", (xattr_long_t) (op->calls - op_base->calls));
+		add_assoc_long(entry, "errors", (xattr_long_t) (op->errors - op_base->errors));
+		add_assoc_long(entry, "bytes", (xattr_long_t) (op->bytes - op_base->bytes));
+		add_assoc_long(entry, "time_ns", (xattr_long_t) (op->nsec - op_base->nsec));
+		xattr_zval_array_init(latency);
+		for (j = 0; j < XATTR_STATS_BUCKETS; j++) {
+			/* The last bucket has no upper bound */
+			if (op->latency[j] != op_base->latency[j]) {
+				add_index_long(latency, j + 1 < XATTR_STATS_BUCKETS ? (xattr_ulong_t) 2 << j : (xattr_ulong_t) -1 >> 1,
+					(xattr_long_t) (op->latency[j] - op_base->latency[j]));
+			}
+		}
+		add_assoc_zval(entry, "latency_ns", latency);
+		add_assoc_zval(ops, (char *) xattr_stats_op_name((xattr_stats_op) i), entry);
+	}
+	add_assoc_zval(array, "ops", ops);
+
+	xattr_zval_array_init(errnos);
+	for (i = 0; i < XATTR_STATS_ERRNOS; i++) {
+		if (stats->errnos[i] != base->errnos[i]) {
+			add_index_long(errnos, i, (xattr_long_t) (stats->errnos[i] - base->errnos[i]));
+		}
+	}
+	add_assoc_zval(array, "errno", errnos);
+}
+/* }}} */
+
+/* {{{ proto array xattr_stats(void)
+   Returns counters of the attribute and open_basedir caches */
+PHP_FUNCTION(xattr_stats)
+{
+	XATTR_ZVAL_DECLARE(request);
+
+	if (zend_parse_parameters_none() == FAILURE) {
+		return;
+	}
+
+	array_init(return_value);
+	add_assoc_long(return_value, "cache_hits", (xattr_long_t) XATTR_G(cache_hits));
+	add_assoc_long(return_value, "cache_misses", (xattr_long_t) XATTR_G(cache_misses));
+	add_assoc_long(return_value, "cache_entries", XATTR_G(cache_table) ? (xattr_long_t) zend_hash_num_elements(XATTR_G(cache_table)) : 0);
+	add_assoc_long(return_value, "cache_bytes", (xattr_long_t) XATTR_G(cache_bytes));
+	add_assoc_long(return_value, "shm_hits", (xattr_long_t) XATTR_G(shm_hits));
+	add_assoc_long(return_value, "shm_misses", (xattr_long_t) XATTR_G(shm_misses));
+	add_assoc_long(return_value, "shm_slots", (xattr_long_t) xattr_shm_slots(xattr_shm_cache));
+	add_assoc_long(return_value, "basedir_hits", (xattr_long_t) XATTR_G(basedir_hits));
+	add_assoc_long(return_value, "basedir_misses", (xattr_long_t) XATTR_G(basedir_misses));
+	add_assoc_long(return_value, "queued_writes", (xattr_long_t) XATTR_G(queue_writes));
+	add_assoc_long(return_value, "coalesced_writes", (xattr_long_t) XATTR_G(queue_coalesced));
+	add_assoc_bool(return_value, "enabled", XATTR_G(stats));
+	php_xattr_stats_add(return_value, 0 TSRMLS_CC);
+	xattr_zval_array_init(request);
+	php_xattr_stats_add(request, 1 TSRMLS_CC);
+	add_assoc_zval(return_value, "request", request);
+}
+/* }}} */
+
+/* {{{ proto bool xattr_stats_reset(void)
+   Zero the counters xattr_stats() reports */
+PHP_FUNCTION(xattr_stats_reset)
+{
+	if (zend_parse_parameters_none() == FAILURE) {
+		return;
+	}
+
+	XATTR_G(cache_hits) = XATTR_G(cache_misses) = 0;
+	XATTR_G(shm_hits) = XATTR_G(shm_misses) = 0;
+	XATTR_G(basedir_hits) = XATTR_G(basedir_misses) = 0;
+	XATTR_G(queue_writes) = XATTR_G(queue_coalesced) = 0;
+	XATTR_G(stats_functions) = 0;
+	xattr_stats_reset();
+	if (XATTR_G(stats_base_taken)) {
+		php_xattr_stats_request(TSRMLS_C);
+	}
+	RETURN_TRUE;
+}
+/* }}} */
+
+/* {{{ proto array xattr_last_error(void)
+   The errno, its message and the function of the last failure, NULL if nothing failed yet */
+PHP_FUNCTION(xattr_last_error)
+{
+	const char *message, *function;
+
+	if (zend_parse_parameters_none() == FAILURE) {
+		return;
+	}
+
+	if (!XATTR_G(last_errno)) {
+		RETURN_NULL();
+	}
+
+	message = strerror(XATTR_G(last_errno));
+	function = XATTR_G(last_function) ? XATTR_G(last_function) : "";
+	array_init(return_value);
+	add_assoc_long(return_value, "errno", XATTR_G(last_errno));
+	xattr_add_assoc_stringl(return_value, "error", sizeof("error") - 1, message, strlen(message));
+	xattr_add_assoc_stringl(return_value, "function", sizeof("function") - 1, function, strlen(function));
+}
+/* }}} */
 
 /*
  * Local variables: